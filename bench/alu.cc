@@ -0,0 +1,77 @@
+// Compares the table-driven ALU with the computed one. Operands are either
+// random, touching the whole 1.75 MiB binary table, or drawn from a few
+// small values, as in a typical counting loop.
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "core/alu.h"
+
+struct Sample
+{
+  Operation op;
+  bool carry;
+  uint8_t Gs1;
+  uint8_t Op2;
+};
+
+static const int kSamples = 1 << 22;
+static const int kRepeats = 8;
+
+static std::vector<Sample> make_samples(bool random_operands)
+{
+  std::mt19937 rng(1);
+  std::vector<Sample> samples(kSamples);
+
+  for (Sample& sample : samples)
+  {
+    sample.op = static_cast<Operation>(
+        static_cast<int>(Operation::kADC) + rng() % 7);
+    sample.carry = rng() & 0x1;
+    sample.Gs1 = random_operands ? rng() : rng() % 16;
+    sample.Op2 = random_operands ? rng() : 1;
+  }
+
+  return samples;
+}
+
+template <typename ALU>
+static double measure(const std::vector<Sample>& samples, ALU alu)
+{
+  uint32_t sink = 0;
+
+  auto begin = std::chrono::steady_clock::now();
+  for (int repeat = 0; repeat < kRepeats; ++repeat)
+  {
+    for (const Sample& sample : samples)
+    {
+      sink += alu(sample.op, sample.carry, sample.Gs1, sample.Op2);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+
+  // Keep the results alive.
+  if (sink == 1) std::printf(" ");
+
+  std::chrono::duration<double, std::nano> elapsed = end - begin;
+  return elapsed.count() / (static_cast<double>(kSamples) * kRepeats);
+}
+
+int main()
+{
+  for (bool random_operands : {true, false})
+  {
+    std::vector<Sample> samples = make_samples(random_operands);
+
+    double computed = measure(samples, compute_alu);
+    double table = measure(samples, lookup_binary_alu);
+
+    std::printf("%-16s computed: %.2f ns/op    table: %.2f ns/op\n",
+                random_operands ? "random operands" : "loop operands",
+                computed, table);
+  }
+
+  return 0;
+}
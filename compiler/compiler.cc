@@ -4,19 +4,16 @@
 #include "compiler/compiler.h"
 #include "utils/str.h"
 
-TemporaryFile Compiler::Compile()
+std::vector<uint16_t> Compiler::Compile()
 try
 {
-  TemporaryFile file;
+  std::vector<uint16_t> program;
 
   for (Node node : root_)
   {
     if (IsInstruction(node))
     {
-      uint16_t opcode = AssembleInstruction(node);
-
-      file.Write(static_cast<uint8_t>(opcode >> 8));
-      file.Write(static_cast<uint8_t>(opcode));
+      program.push_back(AssembleInstruction(node));
     }
     else if (IsDirective(node))
     {
@@ -29,7 +26,7 @@ try
     }
   }
 
-  return file;
+  return program;
 }
 catch (const std::runtime_error&)
 {
@@ -72,12 +69,12 @@ void Compiler::HandleDirective(const Node& node)
 
 inline uint16_t Compiler::AssembleHALT() const
 {
-  return 0x1000;
+  return Encode(Operation::kHALT, {});
 }
 
 inline uint16_t Compiler::AssembleNOP() const
 {
-  return 0x0000;
+  return Encode(Operation::kNOP, {});
 }
 
 uint16_t Compiler::AssembleLOAD(const Node& node) const
@@ -88,15 +85,15 @@ uint16_t Compiler::AssembleLOAD(const Node& node) const
     uint8_t G = GetRegisterCode(node.GetSubNodes()[0].GetString());
     uint8_t P = GetRegisterCode(node.GetSubNodes()[1].GetString());
 
-    return 0x2800 | G << 8 | P;
+    return Encode(Operation::kLOAD, { G, P, 0, 0, false, false });
   }
   else if (IsOperandRegister(node.GetSubNodes()[0]) &&
            IsOperandNumerical(node.GetSubNodes()[1]))
   {
     uint8_t G = GetRegisterCode(node.GetSubNodes()[0].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[1].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[1].GetString()) + origin_;
 
-    return 0x2000 | G << 8 | Imm + origin_;
+    return Encode(Operation::kLOADI, { G, 0, Imm, 0, false, false });
   }
   else
   {
@@ -112,15 +109,15 @@ uint16_t Compiler::AssembleSTORE(const Node& node) const
     uint8_t G = GetRegisterCode(node.GetSubNodes()[0].GetString());
     uint8_t P = GetRegisterCode(node.GetSubNodes()[1].GetString());
 
-    return 0x3800 | G << 8 | P;
+    return Encode(Operation::kSTORE, { G, P, 0, 0, false, false });
   }
   else if (IsOperandRegister(node.GetSubNodes()[0]) &&
            IsOperandNumerical(node.GetSubNodes()[1]))
   {
     uint8_t G = GetRegisterCode(node.GetSubNodes()[0].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[1].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[1].GetString()) + origin_;
 
-    return 0x3000 | G << 8 | Imm + origin_;
+    return Encode(Operation::kSTOREI, { G, 0, Imm, 0, false, false });
   }
   else
   {
@@ -136,9 +133,9 @@ uint16_t Compiler::AssembleCALL(const Node& node) const
       IsOperandNumerical(node.GetSubNodes()[1]))
   {
     uint8_t Cond = GetConditionCode(node.GetSubNodes()[0].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[1].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[1].GetString()) + origin_;
 
-    return 0x8F00 | Cond << 12 | Imm + origin_;
+    return Encode(Operation::kCALL, { 0, 0, Imm, Cond, false, false });
   }
   else if (bNodeHasTwoOperands && IsOperandCondition(node.GetSubNodes()[0]) &&
            IsOperandIdentifier(node.GetSubNodes()[1]))
@@ -148,9 +145,9 @@ uint16_t Compiler::AssembleCALL(const Node& node) const
     if (label != labels_.end())
     {
       uint8_t Cond = GetConditionCode(node.GetSubNodes()[0].GetString());
-      uint8_t Imm = label->second;
+      int Imm = label->second;
 
-      return 0x8F00 | Cond << 12 | Imm;
+      return Encode(Operation::kCALL, { 0, 0, Imm, Cond, false, false });
     }
     else
     {
@@ -160,9 +157,9 @@ uint16_t Compiler::AssembleCALL(const Node& node) const
   }
   else if (IsOperandNumerical(node.GetSubNodes()[0]))
   {
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[0].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[0].GetString()) + origin_;
 
-    return 0x8F00 | Imm + origin_;
+    return Encode(Operation::kCALL, { 0, 0, Imm, 0, false, false });
   }
   else if (IsOperandIdentifier(node.GetSubNodes()[0]))
   {
@@ -170,9 +167,9 @@ uint16_t Compiler::AssembleCALL(const Node& node) const
 
     if (label != labels_.end())
     {
-      uint8_t Imm = label->second;
+      int Imm = label->second;
 
-      return 0x8F00 | Imm;
+      return Encode(Operation::kCALL, { 0, 0, Imm, 0, false, false });
     }
     else
     {
@@ -194,9 +191,9 @@ uint16_t Compiler::AssembleJMP(const Node& node) const
       IsOperandNumerical(node.GetSubNodes()[1]))
   {
     uint8_t Cond = GetConditionCode(node.GetSubNodes()[0].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[1].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[1].GetString()) + origin_;
 
-    return 0x8700 | Cond << 12 | Imm + origin_;
+    return Encode(Operation::kJMP, { 0, 0, Imm, Cond, false, false });
   }
   else if (bNodeHasTwoOperands && IsOperandCondition(node.GetSubNodes()[0]) &&
            IsOperandIdentifier(node.GetSubNodes()[1]))
@@ -206,9 +203,9 @@ uint16_t Compiler::AssembleJMP(const Node& node) const
     if (label != labels_.end())
     {
       uint8_t Cond = GetConditionCode(node.GetSubNodes()[0].GetString());
-      uint8_t Imm = label->second;
+      int Imm = label->second;
 
-      return 0x8700 | Cond << 12 | Imm;
+      return Encode(Operation::kJMP, { 0, 0, Imm, Cond, false, false });
     }
     else
     {
@@ -218,9 +215,9 @@ uint16_t Compiler::AssembleJMP(const Node& node) const
   }
   else if (IsOperandNumerical(node.GetSubNodes()[0]))
   {
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[0].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[0].GetString()) + origin_;
 
-    return 0x8700 | Imm + origin_;
+    return Encode(Operation::kJMP, { 0, 0, Imm, 0, false, false });
   }
   else if (IsOperandIdentifier(node.GetSubNodes()[0]))
   {
@@ -228,9 +225,9 @@ uint16_t Compiler::AssembleJMP(const Node& node) const
 
     if (label != labels_.end())
     {
-      uint8_t Imm = label->second;
+      int Imm = label->second;
 
-      return 0x8700 | Imm;
+      return Encode(Operation::kJMP, { 0, 0, Imm, 0, false, false });
     }
     else
     {
@@ -254,17 +251,17 @@ uint16_t Compiler::AssembleMOVI(const Node& node) const
   {
     uint8_t Cond = GetConditionCode(node.GetSubNodes()[0].GetString());
     uint8_t Gd = GetRegisterCode(node.GetSubNodes()[1].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[2].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[2].GetString());
 
-    return 0x8000 | Cond << 12 | Gd << 8 | Imm;
+    return Encode(Operation::kMOVI, { Gd, 0, Imm, Cond, false, false });
   }
   else if (IsOperandRegister(node.GetSubNodes()[0]) &&
            IsOperandNumerical(node.GetSubNodes()[1]))
   {
     uint8_t Gd = GetRegisterCode(node.GetSubNodes()[0].GetString());
-    uint8_t Imm = asm_stoi(node.GetSubNodes()[1].GetString());
+    int Imm = asm_stoi(node.GetSubNodes()[1].GetString());
 
-    return 0x8000 | Gd << 8 | Imm;
+    return Encode(Operation::kMOVI, { Gd, 0, Imm, 0, false, false });
   }
   else
   {
@@ -280,7 +277,7 @@ uint16_t Compiler::AssembleMOV(const Node& node) const
     uint8_t Gd = GetRegisterCode(node.GetSubNodes()[0].GetString());
     uint8_t Gs = GetRegisterCode(node.GetSubNodes()[1].GetString());
 
-    return 0x1800 | Gd << 8 | Gs << 4;
+    return Encode(Operation::kMOV, { Gd, Gs, 0, 0, false, false });
   }
   else
   {
@@ -290,61 +287,61 @@ uint16_t Compiler::AssembleMOV(const Node& node) const
 
 uint16_t Compiler::AssembleADC(const Node& node) const
 {
-  return AssembleBinaryALU(node, 0);
+  return AssembleBinaryALU(node, Operation::kADC);
 }
 
 uint16_t Compiler::AssembleADD(const Node& node) const
 {
-  return AssembleBinaryALU(node, 1);
+  return AssembleBinaryALU(node, Operation::kADD);
 }
 
 uint16_t Compiler::AssembleSBC(const Node& node) const
 {
-  return AssembleBinaryALU(node, 2);
+  return AssembleBinaryALU(node, Operation::kSBC);
 }
 
 uint16_t Compiler::AssembleSUB(const Node& node) const
 {
-  return AssembleBinaryALU(node, 3);
+  return AssembleBinaryALU(node, Operation::kSUB);
 }
 
 uint16_t Compiler::AssembleAND(const Node& node) const
 {
-  return AssembleBinaryALU(node, 4);
+  return AssembleBinaryALU(node, Operation::kAND);
 }
 
 uint16_t Compiler::AssembleOR(const Node& node) const
 {
-  return AssembleBinaryALU(node, 5);
+  return AssembleBinaryALU(node, Operation::kOR);
 }
 
 uint16_t Compiler::AssembleXOR(const Node& node) const
 {
-  return AssembleBinaryALU(node, 6);
+  return AssembleBinaryALU(node, Operation::kXOR);
 }
 
 uint16_t Compiler::AssembleNOT(const Node& node) const
 {
-  return AssembleUnaryALU(node, 0);
+  return AssembleUnaryALU(node, Operation::kNOT);
 }
 
 uint16_t Compiler::AssembleROR(const Node& node) const
 {
-  return AssembleUnaryALU(node, 1);
+  return AssembleUnaryALU(node, Operation::kROR);
 }
 
 uint16_t Compiler::AssembleSHR(const Node& node) const
 {
-  return AssembleUnaryALU(node, 2);
+  return AssembleUnaryALU(node, Operation::kSHR);
 }
 
 uint16_t Compiler::AssembleRCR(const Node& node) const
 {
-  return AssembleUnaryALU(node, 3);
+  return AssembleUnaryALU(node, Operation::kRCR);
 }
 
 uint16_t Compiler::AssembleBinaryALU(const Node& node,
-                                     uint8_t code) const
+                                     Operation operation) const
 {
   if (IsOperandRegister(node.GetSubNodes()[0]) &&
       IsOperandRegister(node.GetSubNodes()[1]) &&
@@ -356,7 +353,7 @@ uint16_t Compiler::AssembleBinaryALU(const Node& node,
     uint8_t Gs1 = GetRegisterCode(node.GetSubNodes()[1].GetString());
     uint8_t Op2 = GetRegisterCode(node.GetSubNodes()[2].GetString());
 
-    return 0x4000 | code << 11 | Gd << 8 | Gs1 << 4 | r << 3 | Op2;
+    return Encode(operation, { Gd, Gs1, Op2, 0, r, false });
   }
   else if (IsOperandRegister(node.GetSubNodes()[0]) &&
            IsOperandRegister(node.GetSubNodes()[1]) &&
@@ -366,9 +363,9 @@ uint16_t Compiler::AssembleBinaryALU(const Node& node,
 
     uint8_t Gd = r ? GetRegisterCode(node.GetSubNodes()[0].GetString()) : 0;
     uint8_t Gs1 = GetRegisterCode(node.GetSubNodes()[1].GetString());
-    uint8_t Op2 = asm_stoi(node.GetSubNodes()[2].GetString());
+    int Op2 = asm_stoi(node.GetSubNodes()[2].GetString());
 
-    return 0x4000 | code << 11 | Gd << 8 | 1 << 7 | Gs1 << 4 | r << 3 | Op2;
+    return Encode(operation, { Gd, Gs1, Op2, 0, r, true });
   }
   else
   {
@@ -377,7 +374,7 @@ uint16_t Compiler::AssembleBinaryALU(const Node& node,
 }
 
 uint16_t Compiler::AssembleUnaryALU(const Node& node,
-                                     uint8_t code) const
+                                    Operation operation) const
 {
   if (IsOperandRegister(node.GetSubNodes()[0]) &&
       IsOperandRegister(node.GetSubNodes()[1]))
@@ -387,7 +384,7 @@ uint16_t Compiler::AssembleUnaryALU(const Node& node,
     uint8_t Gd = r ? GetRegisterCode(node.GetSubNodes()[0].GetString()) : 0;
     uint8_t Gs = GetRegisterCode(node.GetSubNodes()[1].GetString());
 
-    return 0x7800 | Gd << 8 | Gs << 4 | r << 3 | code << 1;
+    return Encode(operation, { Gd, Gs, 0, 0, r, false });
   }
   else
   {
@@ -395,33 +392,38 @@ uint16_t Compiler::AssembleUnaryALU(const Node& node,
   }
 }
 
+uint16_t Compiler::Encode(Operation operation, const Operands& op) const
+{
+  if (!get_instruction_format(operation).Fits(op))
+  {
+    throw std::runtime_error("operand out of range");
+  }
+
+  return encode(operation, op);
+}
+
 uint8_t Compiler::GetRegisterCode(const std::string& str) const
 {
   std::string name = strtolower(str);
 
-  if (name == "a") return 0;
-  else if (name == "b") return 1;
-  else if (name == "c") return 2;
-  else if (name == "d") return 3;
-  else if (name == "m") return 4;
-  else if (name == "s") return 5;
-  else if (name == "l") return 6;
-  else if (name == "pc") return 7;
-  else throw std::runtime_error("invalid register");
+  for (uint8_t code = 0; code < 8; ++code)
+  {
+    if (name == strtolower(kRegisterNames[code])) return code;
+  }
+
+  throw std::runtime_error("invalid register");
 }
 
 uint8_t Compiler::GetConditionCode(const std::string& str) const
 {
   std::string name = strtolower(str);
 
-  if (name == "a") return 0;
-  else if (name == "z") return 1;
-  else if (name == "ns") return 2;
-  else if (name == "c") return 3;
-  else if (name == "nc") return 4;
-  else if (name == "s") return 5;
-  else if (name == "nz") return 6;
-  else throw std::runtime_error("invalid condition");
+  for (uint8_t code = 0; code < 8; ++code)
+  {
+    if (!name.empty() && name == strtolower(kConditionNames[code])) return code;
+  }
+
+  throw std::runtime_error("invalid condition");
 }
 
 bool Compiler::IsOperandCondition(const Node& op) const
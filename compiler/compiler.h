@@ -2,8 +2,8 @@
 #include <unordered_map>
 
 #include "compiler/ast.h"
+#include "core/instructionset.h"
 #include "utils/str.h"
-#include "utils/tempfile.h"
 
 class Compiler
 {
@@ -15,7 +15,8 @@ class Compiler
     }
 
   public:
-    TemporaryFile Compile();
+    // Returns the words of the program in order.
+    std::vector<uint16_t> Compile();
 
   private:
     uint16_t AssembleInstruction(const Node& node) const;
@@ -78,8 +79,11 @@ class Compiler
     uint16_t AssembleRCR(const Node& node) const;
 
   private:
-    uint16_t AssembleBinaryALU(const Node& node, uint8_t code) const;
-    uint16_t AssembleUnaryALU(const Node& node, uint8_t code) const;
+    // Same as encode(), but throws if an operand does not fit its field.
+    uint16_t Encode(Operation operation, const Operands& op) const;
+
+    uint16_t AssembleBinaryALU(const Node& node, Operation operation) const;
+    uint16_t AssembleUnaryALU(const Node& node, Operation operation) const;
 
   private:
     std::vector<Node> root_;
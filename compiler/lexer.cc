@@ -5,14 +5,15 @@
 std::vector<std::pair<Token, std::string>> Lexer::Tokenize()
 {
   std::vector<std::pair<Token, std::string>> tokens;
+  const TokenExpressions& token_expressions = GetTokenExpressions();
   std::string::const_iterator token_begin = characters_.begin();
 
   while (token_begin < characters_.end())
   {
     std::match_results<std::string::const_iterator> match;
 
-    auto token_expr = token_expressions_.begin();
-    while (token_expr < token_expressions_.end() &&
+    auto token_expr = token_expressions.begin();
+    while (token_expr < token_expressions.end() &&
            !std::regex_search(token_begin, characters_.end(), match,
                               token_expr->first)) ++token_expr;
 
@@ -20,7 +21,7 @@ std::vector<std::pair<Token, std::string>> Lexer::Tokenize()
     {
       throw std::runtime_error("unknown token");
     }
-    else if (token_expr != token_expressions_.end() &&
+    else if (token_expr != token_expressions.end() &&
              token_expr->second != Token::kWhiteSpace &&
              token_expr->second != Token::kComment)
     {
@@ -32,3 +33,90 @@ std::vector<std::pair<Token, std::string>> Lexer::Tokenize()
 
   return tokens;
 }
+
+const Lexer::TokenExpressions& Lexer::GetTokenExpressions()
+{
+  static const TokenExpressions token_expressions = {{
+    { std::regex("^[ :\t\n]+"), Token::kWhiteSpace },
+    { std::regex("^0x[0-9A-Fa-f]+(?=\\W)"), Token::kNumerical },
+    { std::regex("^0b[0-1]+(?=\\W)"), Token::kNumerical },
+    { std::regex("^0[0-7]+(?=\\W)"), Token::kNumerical },
+    { std::regex("^[0-9]+(?=\\W)"), Token::kNumerical },
+    { std::regex("^;[^\n]*"), Token::kComment },
+    { std::regex("^[A-Za-z_]+(?=:)"), Token::kLabel },
+    { std::regex("^,"), Token::kComma },
+    { std::regex("^org(?=\\W)", std::regex_constants::icase),
+                 Token::kDirective },
+    { std::regex("^halt(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^nop(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^load(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^store(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^call(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^jmp(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^movi(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^mov(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^adc(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^add(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^sbc(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^sub(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^and(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^or(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^xor(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^not(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^ror(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^shr(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^rcr(?=\\W)", std::regex_constants::icase),
+                 Token::kInstruction },
+    { std::regex("^f(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^a(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^b(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^c(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^d(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^m(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^s(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^l(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^pc(?=\\W)", std::regex_constants::icase),
+                 Token::kRegister },
+    { std::regex("^z(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^ns(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^c(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^nc(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^s(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^nz(?=\\W)", std::regex_constants::icase),
+                 Token::kCondition },
+    { std::regex("^[A-Za-z][A-Za-z0-9_]*"), Token::kIdentifier }
+  }};
+
+  return token_expressions;
+}
@@ -7,8 +7,24 @@ static std::string file_to_string(const std::string& path);
 
 TemporaryFile run_compiler(const std::string& path)
 {
-  std::string characters = file_to_string(path);
+  TemporaryFile file;
 
+  for (uint16_t word : compile_program(path))
+  {
+    file.Write(static_cast<uint8_t>(word >> 8));
+    file.Write(static_cast<uint8_t>(word));
+  }
+
+  return file;
+}
+
+std::vector<uint16_t> compile_program(const std::string& path)
+{
+  return compile_source(file_to_string(path));
+}
+
+std::vector<uint16_t> compile_source(const std::string& characters)
+{
   std::vector<std::pair<Token, std::string>> tokens;
   try
   {
@@ -1,5 +1,13 @@
 #include "compiler/lexer.h"
 #include "compiler/parser.h"
 #include "compiler/compiler.h"
+#include "utils/tempfile.h"
 
+// Compiles the source file at path into a program file.
 TemporaryFile run_compiler(const std::string& path);
+
+// Compiles the source file at path into the words of the program.
+std::vector<uint16_t> compile_program(const std::string& path);
+
+// Compiles characters of assembler source into the words of the program.
+std::vector<uint16_t> compile_source(const std::string& characters);
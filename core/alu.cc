@@ -0,0 +1,93 @@
+#include <vector>
+
+#include "core/alu.h"
+
+static const int kBinaryOperations = 7;
+static const int kUnaryOperations = 4;
+
+static const std::vector<uint16_t>& get_binary_table();
+static const std::vector<uint16_t>& get_unary_table();
+
+uint16_t compute_alu(Operation op, bool carry, uint8_t Gs1, uint8_t Op2)
+{
+  switch (op)
+  {
+    case Operation::kADC: return Gs1 + Op2 + carry;
+    case Operation::kADD: return Gs1 + Op2;
+    case Operation::kSBC: return (Gs1 - Op2 - carry) & 0x1FF;
+    case Operation::kSUB: return (Gs1 - Op2) & 0x1FF;
+    case Operation::kAND: return Gs1 & Op2;
+    case Operation::kOR: return Gs1 | Op2;
+    case Operation::kXOR: return Gs1 ^ Op2;
+    case Operation::kNOT: return ~Gs1 & 0xFF;
+    case Operation::kROR: return ((Gs1 >> 1) | (Gs1 << 7)) & 0xFF;
+    case Operation::kSHR: return (Gs1 >> 1) | (Gs1 & 0x1) << 8;
+    case Operation::kRCR: return (Gs1 >> 1) | carry << 7 | (Gs1 & 0x1) << 8;
+    default: return 0x0000;
+  }
+}
+
+uint16_t lookup_binary_alu(Operation op, bool carry, uint8_t Gs1, uint8_t Op2)
+{
+  int row = (static_cast<int>(op) - static_cast<int>(Operation::kADC)) * 2 +
+            carry;
+
+  return get_binary_table()[row << 16 | Gs1 << 8 | Op2];
+}
+
+uint16_t lookup_unary_alu(Operation op, bool carry, uint8_t Gs)
+{
+  int row = (static_cast<int>(op) - static_cast<int>(Operation::kNOT)) * 2 +
+            carry;
+
+  return get_unary_table()[row << 8 | Gs];
+}
+
+// Results of ADC to XOR, indexed by operation, carry-in, Gs1 and Op2.
+static const std::vector<uint16_t>& get_binary_table()
+{
+  static const std::vector<uint16_t> table = []()
+  {
+    std::vector<uint16_t> table(kBinaryOperations * 2 * 0x10000);
+
+    for (int row = 0; row < kBinaryOperations * 2; ++row)
+    {
+      Operation op = static_cast<Operation>(
+          static_cast<int>(Operation::kADC) + row / 2);
+
+      for (int operands = 0; operands < 0x10000; ++operands)
+      {
+        table[row << 16 | operands] = compute_alu(op, row % 2, operands >> 8,
+                                                  operands & 0xFF);
+      }
+    }
+
+    return table;
+  }();
+
+  return table;
+}
+
+// Results of NOT to RCR, indexed by operation, carry-in and Gs.
+static const std::vector<uint16_t>& get_unary_table()
+{
+  static const std::vector<uint16_t> table = []()
+  {
+    std::vector<uint16_t> table(kUnaryOperations * 2 * 0x100);
+
+    for (int row = 0; row < kUnaryOperations * 2; ++row)
+    {
+      Operation op = static_cast<Operation>(
+          static_cast<int>(Operation::kNOT) + row / 2);
+
+      for (int Gs = 0; Gs < 0x100; ++Gs)
+      {
+        table[row << 8 | Gs] = compute_alu(op, row % 2, Gs, 0x00);
+      }
+    }
+
+    return table;
+  }();
+
+  return table;
+}
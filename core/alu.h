@@ -0,0 +1,17 @@
+#pragma once
+#include <cstdint>
+
+#include "core/instructionset.h"
+
+// ALU results are returned in the form taken by CPU::SetResult(): the 8-bit
+// result in the low byte and the carry-out in bit 8. S and Z follow from the
+// result.
+
+// Computes the result of a binary (ADC to XOR) or unary (NOT to RCR)
+// operation. Op2 is ignored by unary operations.
+uint16_t compute_alu(Operation op, bool carry, uint8_t Gs1, uint8_t Op2);
+
+// Same as compute_alu(), but reads the result from tables of every operation,
+// carry-in and operands. The tables are built on first use.
+uint16_t lookup_binary_alu(Operation op, bool carry, uint8_t Gs1, uint8_t Op2);
+uint16_t lookup_unary_alu(Operation op, bool carry, uint8_t Gs);
@@ -0,0 +1,416 @@
+#include <sstream>
+
+#include "core/aot.h"
+#include "core/cpu.h"
+#include "core/disassembler.h"
+#include "utils/str.h"
+
+typedef DecodedInstruction::Handler Handler;
+
+static const char* const kPrologue =
+R"(// Generated by relay-emulator. Do not edit.
+#include <cstdint>
+
+struct RelayState
+{
+  uint8_t registers[8];
+  bool sign;
+  bool zero;
+  bool carry;
+  bool halted;
+  uint16_t instruction;
+  uint64_t budget;
+  uint8_t input[2];
+};
+
+)";
+
+// Translates one instruction at a time into C++ statements.
+class CppTranslator
+{
+  public:
+    CppTranslator(std::ostringstream& out,
+                  const std::array<bool, ROM::kAddressSpaceSize>& targets)
+        : out_(out), targets_(targets)
+    {
+    }
+
+  public:
+    void Instruction(uint8_t pc, const DecodedInstruction& op);
+
+  private:
+    // Returns the expression of the value of register code. PC reads as the
+    // address of the next instruction.
+    static std::string Register(uint8_t pc, uint8_t code);
+    static std::string Condition(uint8_t cond);
+    static std::string Hex(int value) { return "0x" + to_hex_string(value, 2); }
+
+    // Writes value to register code. A write to PC continues at the new
+    // address.
+    void Store(uint8_t code, const std::string& value);
+
+    // Continues at addr, directly if it is a translated jump target.
+    void Jump(uint8_t addr);
+
+    void BinaryALU(uint8_t pc, const DecodedInstruction& op);
+    void UnaryALU(uint8_t pc, const DecodedInstruction& op);
+
+    // Sets t to value truncated to 8 bits.
+    void Result(const std::string& value);
+
+    // Sets the zero and sign flags from t.
+    void Flags();
+
+  private:
+    std::ostringstream& out_;
+
+    // Addresses that have a label, because CALL or JMP go there.
+    const std::array<bool, ROM::kAddressSpaceSize>& targets_;
+};
+
+// Returns true if the word at addr is known when the program is translated.
+static bool is_translated(int addr)
+{
+  return addr < ROM::kProgramDataSize ||
+         addr >= ROM::kProgramDataSize + ROM::kInputSwitchesSize / 8;
+}
+
+static uint16_t get_word(
+    const std::array<uint16_t, ROM::kProgramDataSize>& program, int addr)
+{
+  return addr < ROM::kProgramDataSize ? program[addr] : 0x0000;
+}
+
+std::string translate_to_cpp(
+    const std::array<uint16_t, ROM::kProgramDataSize>& program)
+{
+  std::ostringstream out;
+  out << kPrologue;
+
+  out << "static const uint8_t kMemory[" << ROM::kAddressSpaceSize
+      << "] = {";
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    uint8_t value = addr < ROM::kProgramDataSize ? program[addr] & 0x00FF : 0;
+    out << (addr % 12 ? " " : "\n  ") << "0x" << to_hex_string(value, 2)
+        << (addr + 1 < ROM::kAddressSpaceSize ? "," : "");
+  }
+  out << "\n};\n\n";
+
+  out << "static inline uint8_t relay_read(const RelayState* state, "
+         "uint8_t addr)\n"
+         "{\n"
+         "  if (addr == 0x80) return state->input[0];\n"
+         "  if (addr == 0x81) return state->input[1];\n"
+         "  return kMemory[addr];\n"
+         "}\n\n";
+
+  out << "extern \"C\" uint64_t " << kTranslatedFunctionName
+      << "(RelayState* state)\n"
+         "{\n"
+         "  uint8_t A = state->registers[0];\n"
+         "  uint8_t B = state->registers[1];\n"
+         "  uint8_t C = state->registers[2];\n"
+         "  uint8_t D = state->registers[3];\n"
+         "  uint8_t M = state->registers[4];\n"
+         "  uint8_t S = state->registers[5];\n"
+         "  uint8_t L = state->registers[6];\n"
+         "  uint8_t PC = state->registers[7];\n"
+         "  bool fS = state->sign;\n"
+         "  bool fZ = state->zero;\n"
+         "  bool fCY = state->carry;\n"
+         "  uint16_t IR = state->instruction;\n"
+         "  uint64_t budget = state->budget;\n"
+         "  uint64_t executed = 0;\n"
+         "  uint8_t t;\n"
+         "\n"
+         "  state->halted = false;\n"
+         "\n"
+         "dispatch:\n"
+         "  switch (PC)\n"
+         "  {\n";
+
+  std::array<bool, ROM::kAddressSpaceSize> targets = {};
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    DecodedInstruction op = decode(get_word(program, addr));
+    bool jumps = op.handler == Handler::kCALL || op.handler == Handler::kJMP;
+
+    if (jumps && is_translated(op.Op2)) targets[op.Op2] = true;
+  }
+
+  CppTranslator translator(out, targets);
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    if (is_translated(addr))
+    {
+      translator.Instruction(addr, decode(get_word(program, addr)));
+    }
+  }
+
+  out << "    default:\n"
+         "      // Input switch words are executed by the interpreter.\n"
+         "      goto done;\n"
+         "  }\n"
+         "\n"
+         "done:\n"
+         "  state->registers[0] = A;\n"
+         "  state->registers[1] = B;\n"
+         "  state->registers[2] = C;\n"
+         "  state->registers[3] = D;\n"
+         "  state->registers[4] = M;\n"
+         "  state->registers[5] = S;\n"
+         "  state->registers[6] = L;\n"
+         "  state->registers[7] = PC;\n"
+         "  state->sign = fS;\n"
+         "  state->zero = fZ;\n"
+         "  state->carry = fCY;\n"
+         "  state->instruction = IR;\n"
+         "  state->budget = budget - executed;\n"
+         "  return executed;\n"
+         "}\n";
+
+  return out.str();
+}
+
+void CppTranslator::Instruction(uint8_t pc, const DecodedInstruction& op)
+{
+  uint8_t next = pc + 1;
+
+  out_ << "    // " << Hex(pc) << ": " << disassemble(op.instruction) << "\n"
+       << "    case " << Hex(pc) << ":\n";
+
+  if (targets_[pc]) out_ << "    label_" << Hex(pc) << ":\n";
+
+  out_ << "      if (executed == budget) { PC = " << Hex(pc)
+       << "; goto done; }\n"
+       << "      ++executed;\n"
+       << "      IR = 0x" << to_hex_string(op.instruction, 4) << ";\n";
+
+  switch (op.handler)
+  {
+    case Handler::kHALT:
+    {
+      out_ << "      PC = " << Hex(next) << ";\n"
+           << "      state->halted = true;\n"
+           << "      goto done;\n";
+      return;
+    }
+    case Handler::kLOAD: case Handler::kLOADI:
+    {
+      if (op.handler == Handler::kLOADI)
+      {
+        Store(op.Gd, "relay_read(state, " + Hex(op.Op2) + ")");
+      }
+      else if (op.Gs > CPU::kM)
+      {
+        Store(op.Gd, "relay_read(state, " + Register(pc, op.Gs) + ")");
+      }
+      break;
+    }
+    case Handler::kCALL:
+    {
+      out_ << "      if (" << Condition(op.cond) << ")\n"
+           << "      {\n"
+           << "        L = " << Hex(next) << ";\n  ";
+      Jump(op.Op2);
+      out_ << "      }\n";
+      break;
+    }
+    case Handler::kJMP:
+    {
+      out_ << "      if (" << Condition(op.cond) << ")\n"
+           << "      {\n  ";
+      Jump(op.Op2);
+      out_ << "      }\n";
+      break;
+    }
+    case Handler::kMOVI:
+    {
+      out_ << "      if (" << Condition(op.cond) << ") "
+           << Register(pc, op.Gd) << " = " << Hex(op.Op2) << ";\n";
+      break;
+    }
+    case Handler::kMOV:
+    {
+      Store(op.Gd, Register(pc, op.Gs));
+      break;
+    }
+    case Handler::kNOP: case Handler::kSTORE: case Handler::kSTOREI:
+    {
+      // Bus::Write ignores stores.
+      break;
+    }
+    case Handler::kNOT: case Handler::kROR: case Handler::kSHR:
+    case Handler::kRCR:
+    {
+      UnaryALU(pc, op);
+      break;
+    }
+    default:
+    {
+      BinaryALU(pc, op);
+      break;
+    }
+  }
+
+  // Straight-line code falls through to the next case, unless the next word
+  // is not translated or PC wraps around.
+  if (next == 0 || !is_translated(next))
+  {
+    out_ << "      PC = " << Hex(next) << ";\n"
+         << "      goto dispatch;\n";
+  }
+  else
+  {
+    out_ << "      // Falls through\n";
+  }
+}
+
+void CppTranslator::BinaryALU(uint8_t pc, const DecodedInstruction& op)
+{
+  std::string x = Register(pc, op.Gs);
+  std::string y = op.HasImmediate() ? std::to_string(op.Op2) :
+                                      Register(pc, op.Op2);
+
+  // The result in int, with the carry-out in bit 8 for the arithmetic
+  std::string result;
+
+  switch (op.handler)
+  {
+    case Handler::kADC:
+      result = x + " + " + y + " + fCY";
+      break;
+    case Handler::kADD:
+      result = x + " + " + y;
+      break;
+    case Handler::kSBC:
+      result = x + " - " + y + " - fCY";
+      break;
+    case Handler::kSUB:
+      result = x + " - " + y;
+      break;
+    case Handler::kAND:
+      result = x + " & " + y;
+      break;
+    case Handler::kOR:
+      result = x + " | " + y;
+      break;
+    case Handler::kXOR: default:
+      result = x + " ^ " + y;
+      break;
+  }
+
+  Result(result);
+
+  switch (op.handler)
+  {
+    case Handler::kADC: case Handler::kADD: case Handler::kSBC:
+    case Handler::kSUB:
+      out_ << "      fCY = ((" << result << ") >> 8) & 0x1;\n";
+      break;
+    default:
+      out_ << "      fCY = false;\n";
+      break;
+  }
+
+  Flags();
+
+  if (op.WritesResult()) Store(op.Gd, "t");
+}
+
+void CppTranslator::UnaryALU(uint8_t pc, const DecodedInstruction& op)
+{
+  std::string x = Register(pc, op.Gs);
+
+  switch (op.handler)
+  {
+    case Handler::kNOT:
+      Result("~" + x);
+      out_ << "      fCY = false;\n";
+      break;
+    case Handler::kROR:
+      Result("(" + x + " >> 1) | (" + x + " << 7)");
+      out_ << "      fCY = false;\n";
+      break;
+    case Handler::kSHR:
+      Result(x + " >> 1");
+      out_ << "      fCY = " << x << " & 0x1;\n";
+      break;
+    case Handler::kRCR: default:
+      Result("(" + x + " >> 1) | (fCY << 7)");
+      out_ << "      fCY = " << x << " & 0x1;\n";
+      break;
+  }
+
+  Flags();
+
+  if (op.WritesResult()) Store(op.Gd, "t");
+}
+
+void CppTranslator::Result(const std::string& value)
+{
+  // Operands may all be constants, and a constant out of range of uint8_t
+  // would warn.
+  out_ << "      t = static_cast<uint8_t>(" << value << ");\n";
+}
+
+void CppTranslator::Flags()
+{
+  out_ << "      fZ = t == 0;\n"
+       << "      fS = t >> 7;\n";
+}
+
+void CppTranslator::Jump(uint8_t addr)
+{
+  if (targets_[addr])
+  {
+    out_ << "      goto label_" << Hex(addr) << ";\n";
+  }
+  else
+  {
+    out_ << "      PC = " << Hex(addr) << "; goto dispatch;\n";
+  }
+}
+
+void CppTranslator::Store(uint8_t code, const std::string& value)
+{
+  if (code == CPU::kPC)
+  {
+    out_ << "      PC = " << value << ";\n"
+         << "      goto dispatch;\n";
+  }
+  else
+  {
+    out_ << "      " << Register(0, code) << " = " << value << ";\n";
+  }
+}
+
+std::string CppTranslator::Register(uint8_t pc, uint8_t code)
+{
+  const char* const kNames[] = { "A", "B", "C", "D", "M", "S", "L" };
+
+  if (code == CPU::kPC)
+  {
+    return Hex(static_cast<uint8_t>(pc + 1));
+  }
+  else
+  {
+    return kNames[code];
+  }
+}
+
+std::string CppTranslator::Condition(uint8_t cond)
+{
+  switch (cond)
+  {
+    case 0b000: return "true";
+    case 0b001: return "fZ";
+    case 0b010: return "!fS";
+    case 0b011: return "fCY";
+    case 0b100: return "!fCY";
+    case 0b101: return "fS";
+    case 0b110: return "!fZ";
+    default: return "false";
+  }
+}
@@ -0,0 +1,41 @@
+#pragma once
+#include <array>
+#include <string>
+
+#include "core/rom.h"
+
+// Machine state passed to the function generated by translate_to_cpp(). The
+// generated source defines the same structure, so it can be compiled on its
+// own and loaded or linked into a test harness.
+struct RelayState
+{
+  // Indexed by CPU::RegisterCode
+  uint8_t registers[8];
+
+  bool sign;
+  bool zero;
+  bool carry;
+  bool halted;
+
+  // Last executed instruction
+  uint16_t instruction;
+
+  // Number of instructions that may still be executed
+  uint64_t budget;
+
+  // Values of the input switches at 0x80 and 0x81
+  uint8_t input[2];
+};
+
+// Name of the generated function:
+//   extern "C" uint64_t relay_run(RelayState* state);
+// It runs the program until HALT or until the budget is exhausted and returns
+// the number of executed instructions. The input switch words are not known
+// when the program is translated, so the function also returns when PC reaches
+// them, leaving the rest of the budget to an interpreter.
+const char* const kTranslatedFunctionName = "relay_run";
+
+// Returns a standalone C++ translation unit that executes the program with
+// the same results as the interpreter.
+std::string translate_to_cpp(
+    const std::array<uint16_t, ROM::kProgramDataSize>& program);
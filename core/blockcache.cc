@@ -0,0 +1,166 @@
+#include "core/blockcache.h"
+
+typedef DecodedInstruction::Handler Handler;
+
+static const uint8_t kM = 0x04;
+static const uint8_t kL = 0x06;
+static const uint8_t kPC = 0x07;
+
+// Records a read of register code by the block analysed by analyze().
+static void read_register(Block& block, uint8_t code)
+{
+  if (code == kPC || (block.written >> code & 0x1)) return;
+
+  for (uint8_t live : block.live_in)
+  {
+    if (live == code) return;
+  }
+
+  block.live_in.push_back(code);
+}
+
+static void read_flags(Block& block)
+{
+  if (!block.writes_flags) block.flags_live_in = true;
+}
+
+static void read_condition(Block& block, uint8_t cond)
+{
+  if (cond != 0b000 && cond != 0b111) read_flags(block);
+}
+
+// Fills the live-in and written sets of block.
+static void analyze(Block& block)
+{
+  block.written = 1 << kPC;
+
+  for (const DecodedInstruction& op : block.instructions)
+  {
+    switch (op.handler)
+    {
+      case Handler::kHALT: case Handler::kNOP: case Handler::kSTORE:
+      case Handler::kSTOREI:
+        break;
+      case Handler::kLOAD:
+        if (op.Gs > kM)
+        {
+          read_register(block, op.Gs);
+          block.reads_memory = true;
+          block.written |= 1 << op.Gd;
+        }
+        break;
+      case Handler::kLOADI:
+        block.reads_memory = true;
+        block.written |= 1 << op.Gd;
+        break;
+      case Handler::kCALL:
+        // A CALL not taken leaves L as it was.
+        read_condition(block, op.cond);
+        if (op.cond != 0b000) read_register(block, kL);
+        block.written |= 1 << kL;
+        break;
+      case Handler::kJMP:
+        read_condition(block, op.cond);
+        break;
+      case Handler::kMOVI:
+        read_condition(block, op.cond);
+        if (op.cond != 0b000) read_register(block, op.Gd);
+        block.written |= 1 << op.Gd;
+        break;
+      case Handler::kMOV:
+        read_register(block, op.Gs);
+        block.written |= 1 << op.Gd;
+        break;
+      default:
+        read_register(block, op.Gs);
+        if (op.handler < Handler::kNOT && !op.HasImmediate())
+        {
+          read_register(block, op.Op2);
+        }
+        if (op.handler == Handler::kADC || op.handler == Handler::kSBC ||
+            op.handler == Handler::kRCR)
+        {
+          read_flags(block);
+        }
+        if (op.WritesResult()) block.written |= 1 << op.Gd;
+        block.writes_flags = true;
+        break;
+    }
+  }
+}
+
+Block& BlockCache::Get(uint8_t pc, const Program& program)
+{
+  if (!blocks_[pc])
+  {
+    blocks_[pc] = Translate(pc, program);
+  }
+
+  return *blocks_[pc];
+}
+
+void BlockCache::Invalidate()
+{
+  for (std::unique_ptr<Block>& block : blocks_)
+  {
+    block.reset();
+  }
+}
+
+void BlockCache::Invalidate(uint8_t addr)
+{
+  std::array<bool, ROM::kAddressSpaceSize> dropped = {};
+
+  for (const std::unique_ptr<Block>& block : blocks_)
+  {
+    if (block && static_cast<uint8_t>(addr - block->entry) <
+                 block->instructions.size())
+    {
+      dropped[block->entry] = true;
+    }
+  }
+
+  // Links to dropped blocks would dangle, so they are cut before the blocks
+  // are freed.
+  for (const std::unique_ptr<Block>& block : blocks_)
+  {
+    if (!block) continue;
+
+    for (Block*& successor : block->successors)
+    {
+      if (successor && dropped[successor->entry]) successor = nullptr;
+    }
+  }
+
+  for (int entry = 0; entry < ROM::kAddressSpaceSize; ++entry)
+  {
+    if (dropped[entry])
+    {
+      blocks_[entry].reset();
+    }
+    else if (blocks_[entry] && blocks_[entry]->reads_memory)
+    {
+      blocks_[entry]->summaries.clear();
+    }
+  }
+}
+
+std::unique_ptr<Block> BlockCache::Translate(uint8_t pc,
+                                             const Program& program) const
+{
+  std::unique_ptr<Block> block(new Block);
+  block->entry = pc;
+
+  for (int size = 0; size < kMaxBlockSize; ++size)
+  {
+    const DecodedInstruction& op = program[pc++];
+    block->instructions.push_back(op);
+
+    if (op.ChangesControlFlow()) break;
+  }
+
+  block->loop = recognize_counting_loop(program, block->entry);
+  analyze(*block);
+
+  return block;
+}
@@ -0,0 +1,81 @@
+#pragma once
+#include <array>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+#include "core/decoder.h"
+#include "core/loops.h"
+#include "core/rom.h"
+
+// Effect of one execution of a block: the registers and the ALU result it
+// left. Only the registers the block writes are meaningful.
+struct BlockSummary
+{
+  uint8_t registers[8];
+  uint16_t alu_result;
+};
+
+// Straight-line run of predecoded instructions. A block ends with the first
+// instruction that may change control flow: JMP, CALL, HALT or any write to PC.
+struct Block
+{
+  uint8_t entry = 0x00;
+  std::vector<DecodedInstruction> instructions;
+
+  // Blocks most recently executed after this one. Hot loops go from block to
+  // block through these links without looking up the cache.
+  std::array<Block*, 2> successors = {};
+
+  // Set if the block is a counting loop (see core/loops.h), which is then
+  // executed as a whole instead of iteration by iteration.
+  std::unique_ptr<CountingLoop> loop;
+
+  // Registers the block reads before writing them, by code, and whether it
+  // reads a flag before an ALU operation sets them. PC is never live-in, as
+  // its value is known at every instruction of the block.
+  std::vector<uint8_t> live_in;
+  bool flags_live_in = false;
+
+  // Registers the block may write, one bit per code. PC is always included.
+  uint8_t written = 0x00;
+  bool writes_flags = false;
+
+  // Set if the block reads memory. Its summaries then depend on other words.
+  bool reads_memory = false;
+
+  // Effects of the block keyed by its live-in values (see
+  // BasicCPU::RunMemoized()).
+  std::unordered_map<uint64_t, BlockSummary> summaries;
+};
+
+class BlockCache
+{
+  public:
+    static const int kMaxBlockSize = 32;
+
+    // Most summaries memoised per block
+    static const size_t kMaxSummaries = 4096;
+    typedef std::array<DecodedInstruction, ROM::kAddressSpaceSize> Program;
+
+  public:
+    // Returns the block starting at pc, translating it on first use.
+    Block& Get(uint8_t pc, const Program& program);
+
+    // Drops every translated block. Called whenever the program changes.
+    void Invalidate();
+
+    // Drops only the blocks that contain addr, and the summaries of blocks
+    // that read memory. Called when one word changes.
+    void Invalidate(uint8_t addr);
+
+  private:
+    // Counting loops are recognised per block, so they must fit in one.
+    static_assert(CountingLoop::kMaxSize <= kMaxBlockSize,
+                  "counting loops must fit in a block");
+
+    std::unique_ptr<Block> Translate(uint8_t pc, const Program& program) const;
+
+  private:
+    std::array<std::unique_ptr<Block>, ROM::kAddressSpaceSize> blocks_;
+};
@@ -3,70 +3,199 @@
 
 #include "core/bus.h"
 #include "core/disassembler.h"
+#include "utils/str.h"
 
-Bus::Bus()
+template <class HookPolicy>
+BasicBus<HookPolicy>::BasicBus() : cpu_(this)
 {
-  cpu_ = std::unique_ptr<CPU>(new CPU(this));
+  Predecode(0, ROM::kAddressSpaceSize);
 }
 
-void Bus::Cycle()
+template <class HookPolicy>
+BasicBus<HookPolicy>::BasicBus(BasicBus&& other) : cpu_(this)
+{
+  *this = std::move(other);
+}
+
+template <class HookPolicy>
+BasicBus<HookPolicy>& BasicBus<HookPolicy>::operator=(BasicBus&& other)
+{
+  stopped_ = other.stopped_;
+  cpu_ = other.cpu_;
+  cpu_.ConnectBus(this);
+  rom_ = other.rom_;
+  program_ = other.program_;
+  blocks_ = std::move(other.blocks_);
+  jit_ = std::move(other.jit_);
+
+  return *this;
+}
+
+template <class HookPolicy>
+void BasicBus<HookPolicy>::ConnectROM(const ROM& rom)
+{
+  rom_ = rom;
+  Predecode(0, ROM::kAddressSpaceSize);
+}
+
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Cycle()
 {
   if (!Stopped())
   {
-    cpu_->Cycle();
+    cpu_.Cycle();
   }
 }
 
-uint16_t Bus::Read(uint8_t addr) const
+template <class HookPolicy>
+uint64_t BasicBus<HookPolicy>::Run(uint64_t budget)
 {
-  if (addr < ROM::kProgramDataSize)
+  if (!Stopped())
   {
-    return rom_.ReadProgramData(addr);
+    return cpu_.Run(budget);
   }
-  else if (addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize)
+
+  return 0;
+}
+
+template <class HookPolicy>
+uint64_t BasicBus<HookPolicy>::RunBlocks(uint64_t budget)
+{
+  if (!Stopped())
   {
-    return rom_.ReadInputSwitches(addr);
+    return cpu_.RunBlocks(budget);
   }
-  else
+
+  return 0;
+}
+
+template <class HookPolicy>
+uint64_t BasicBus<HookPolicy>::RunMemoized(uint64_t budget)
+{
+  if (!Stopped())
   {
-    // Unused (read as 0)
-    return rom_.ReadUnused(addr);
+    return cpu_.RunMemoized(budget);
   }
+
+  return 0;
 }
 
-void Bus::Write(uint8_t addr, uint8_t value)
+template <class HookPolicy>
+uint64_t BasicBus<HookPolicy>::RunNative(uint64_t budget)
 {
+  if (!Stopped())
+  {
+    return cpu_.RunNative(budget);
+  }
+
+  return 0;
 }
 
-void Bus::Input(uint8_t first, uint8_t second)
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Patch(uint8_t addr, uint16_t word)
+{
+  if (addr >= ROM::kProgramDataSize)
+  {
+    throw std::runtime_error("bus: can't patch address 0x" +
+                             to_hex_string(addr, 2) + " outside program data");
+  }
+
+  rom_.WriteProgramData(addr, word);
+  program_[addr] = decode(word);
+  blocks_.Invalidate(addr);
+
+  // Native code is one translation of the whole program, retranslated on the
+  // next native run.
+  jit_.Invalidate();
+}
+
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Input(uint8_t first, uint8_t second)
 {
   rom_.Input(first, second);
+
+  // Input switches are readable, so their decoded copies must follow them.
+  // Only the blocks derived from words that changed are dropped, so the
+  // others keep their memoised summaries from one input to the next.
+  for (int addr = ROM::kProgramDataSize;
+       addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize; ++addr)
+  {
+    uint16_t word = Read(addr);
+
+    if (program_[addr].instruction != word)
+    {
+      program_[addr] = decode(word);
+      blocks_.Invalidate(addr);
+    }
+  }
+
+  jit_.Input(program_);
+}
+
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Predecode(int begin, int end)
+{
+  for (int addr = begin; addr < end; ++addr)
+  {
+    program_[addr] = decode(Read(addr));
+  }
+
+  blocks_.Invalidate();
+  jit_.Invalidate();
 }
 
-void Bus::Reset()
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Reset()
 {
   stopped_ = false;
-  cpu_->Reset();
+  cpu_.Reset();
+}
+
+template <class HookPolicy>
+MachineSnapshot BasicBus<HookPolicy>::Snapshot() const
+{
+  MachineSnapshot snapshot;
+
+  snapshot.state = cpu_.GetState();
+  snapshot.input = { rom_.ReadInputSwitches(0x80),
+                     rom_.ReadInputSwitches(0x81) };
+  snapshot.stopped = stopped_;
+
+  return snapshot;
+}
+
+template <class HookPolicy>
+void BasicBus<HookPolicy>::Restore(const MachineSnapshot& snapshot)
+{
+  if (rom_.ReadInputSwitches(0x80) != snapshot.input[0] ||
+      rom_.ReadInputSwitches(0x81) != snapshot.input[1])
+  {
+    Input(snapshot.input[0], snapshot.input[1]);
+  }
+
+  cpu_.SetState(snapshot.state);
+  stopped_ = snapshot.stopped;
 }
 
-Bus::DebugInfo Bus::GetDebugInfo() const
+template <class HookPolicy>
+typename BasicBus<HookPolicy>::DebugInfo BasicBus<HookPolicy>::GetDebugInfo() const
 {
   DebugInfo info;
 
-  info.instruction = disassemble(cpu_->GetInstructionRegister());
+  info.instruction = disassemble(cpu_.GetInstructionRegister());
 
-  info.registers.A = cpu_->GetRegister(CPU::kA);
-  info.registers.B = cpu_->GetRegister(CPU::kB);
-  info.registers.C = cpu_->GetRegister(CPU::kC);
-  info.registers.D = cpu_->GetRegister(CPU::kD);
-  info.registers.M = cpu_->GetRegister(CPU::kM);
-  info.registers.S = cpu_->GetRegister(CPU::kS);
-  info.registers.L = cpu_->GetRegister(CPU::kL);
-  info.registers.PC = cpu_->GetRegister(CPU::kPC);
+  info.registers.A = cpu_.GetRegister(CPUBase::kA);
+  info.registers.B = cpu_.GetRegister(CPUBase::kB);
+  info.registers.C = cpu_.GetRegister(CPUBase::kC);
+  info.registers.D = cpu_.GetRegister(CPUBase::kD);
+  info.registers.M = cpu_.GetRegister(CPUBase::kM);
+  info.registers.S = cpu_.GetRegister(CPUBase::kS);
+  info.registers.L = cpu_.GetRegister(CPUBase::kL);
+  info.registers.PC = cpu_.GetRegister(CPUBase::kPC);
 
-  info.flags.S = cpu_->GetFlag(CPU::Flag::kS);
-  info.flags.Z = cpu_->GetFlag(CPU::Flag::kZ);
-  info.flags.CY = cpu_->GetFlag(CPU::Flag::kCY);
+  info.flags.S = cpu_.GetFlag(CPUBase::Flag::kS);
+  info.flags.Z = cpu_.GetFlag(CPUBase::Flag::kZ);
+  info.flags.CY = cpu_.GetFlag(CPUBase::Flag::kCY);
 
   for (int addr = 0; addr < info.memory.program_data.size(); ++addr)
   {
@@ -82,4 +211,7 @@ Bus::DebugInfo Bus::GetDebugInfo() const
   }
 
   return info;
-};
+}
+
+template class BasicBus<NoHooks>;
+template class BasicBus<DebugHooks>;
@@ -1,10 +1,25 @@
 #pragma once
 #include <array>
 
+#include "core/blockcache.h"
 #include "core/cpu.h"
+#include "core/jit.h"
 #include "core/rom.h"
 
-class Bus
+// State of a machine apart from its program, which stays with the machine:
+// restoring a snapshot into a machine with the same program continues from the
+// same point.
+struct MachineSnapshot
+{
+  CPUBase::State state;
+  std::array<uint8_t, 2> input;
+  bool stopped;
+};
+
+// Bus parameterised on the hook policy of its CPU (see core/hooks.h). The CPU
+// is stored inline and calls the bus without indirection.
+template <class HookPolicy>
+class BasicBus
 {
   public:
     // Used for GUI display and debugging.
@@ -39,28 +54,88 @@ class Bus
       std::string instruction = "NOP";
     };
 
+    typedef BasicCPU<BasicBus, HookPolicy> CPUType;
+
   public:
-    Bus();
+    BasicBus();
 
     // Movable only
-    Bus(const Bus&) = delete;
-    Bus& operator=(const Bus&) = delete;
-    Bus(Bus&&) = default;
-    Bus& operator=(Bus&&) = default;
+    BasicBus(const BasicBus&) = delete;
+    BasicBus& operator=(const BasicBus&) = delete;
+    BasicBus(BasicBus&& other);
+    BasicBus& operator=(BasicBus&& other);
 
   public:
-    // Used for easy program load.
-    void ConnectROM(const ROM& rom) { rom_ = rom; }
+    // Used for easy program load. Predecodes the whole address space.
+    void ConnectROM(const ROM& rom);
 
     // Performs one instruction cycle.
     void Cycle();
 
+    // Runs the CPU until it halts or executes budget instructions. Returns the
+    // number of executed instructions.
+    uint64_t Run(uint64_t budget);
+
+    // Same as Run(), but executes whole translated blocks.
+    uint64_t RunBlocks(uint64_t budget);
+
+    // Same as Run(), but replays memoised block effects.
+    uint64_t RunMemoized(uint64_t budget);
+
+    // Same as Run(), but executes native code where the host supports it.
+    uint64_t RunNative(uint64_t budget);
+
     // Stops the clock and program execution.
     void StopClock() { stopped_ = true; }
     bool Stopped() const { return stopped_; }
 
-    uint16_t Read(uint8_t addr) const;
-    void Write(uint8_t addr, uint8_t value);
+    // Restarts the clock if it was stopped at a breakpoint. The instruction
+    // there is executed next without breaking again.
+    void Resume()
+    {
+      if (cpu_.AtBreakpoint()) stopped_ = false;
+    }
+
+    uint16_t Read(uint8_t addr) const
+    {
+      if (addr < ROM::kProgramDataSize)
+      {
+        return rom_.ReadProgramData(addr);
+      }
+      else if (addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize)
+      {
+        return rom_.ReadInputSwitches(addr);
+      }
+      else
+      {
+        // Unused (read as 0)
+        return rom_.ReadUnused(addr);
+      }
+    }
+
+    // Returns the predecoded instruction stored at addr.
+    const DecodedInstruction& Fetch(uint8_t addr) const
+    {
+      return program_[addr];
+    }
+
+    // Returns the translated block starting at addr.
+    Block& FetchBlock(uint8_t addr) { return blocks_.Get(addr, program_); }
+
+    // Runs the native translation of the program on state. Returns false if
+    // there is none (see JIT::Execute()).
+    bool ExecuteNative(JIT::State& state)
+    {
+      return jit_.Execute(state, program_);
+    }
+
+    void Write(uint8_t, uint8_t) {}
+
+    // Replaces the program word at addr, keeping the machine state, and drops
+    // only what was derived from that word. A machine paused in the middle of
+    // its program, between calls to Run() or Cycle(), continues with the new
+    // word. Must not be called during one of those calls, e.g. from a hook.
+    void Patch(uint8_t addr, uint16_t word);
 
     // Emulates input switches. Used for easy input.
     void Input(uint8_t first, uint8_t second);
@@ -68,11 +143,34 @@ class Bus
     // Resets CPU and sets stopped_ to false.
     void Reset();
 
+    MachineSnapshot Snapshot() const;
+
+    // Returns the machine to snapshot. Input words are decoded again only if
+    // the input differs. Must not be called while the CPU runs.
+    void Restore(const MachineSnapshot& snapshot);
+
     DebugInfo GetDebugInfo() const;
 
+    const CPUBase::State& GetState() const { return cpu_.GetState(); }
+
+    HookPolicy& GetHooks() { return cpu_.GetHooks(); }
+    const HookPolicy& GetHooks() const { return cpu_.GetHooks(); }
+
+  private:
+    // Decodes words in [begin, end) into program_ and drops translated code.
+    void Predecode(int begin, int end);
+
   private:
     bool stopped_ = false;
 
-    std::unique_ptr<CPU> cpu_;
+    CPUType cpu_;
     ROM rom_;
+
+    // Decoded copy of every readable word, indexed by address.
+    BlockCache::Program program_;
+
+    BlockCache blocks_;
+    JIT jit_;
 };
+
+typedef BasicBus<DefaultHooks> Bus;
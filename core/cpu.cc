@@ -1,354 +1,574 @@
+#include <cstring>
 #include <sstream>
 
+#include "core/alu.h"
+#include "core/bus.h"
 #include "core/cpu.h"
-#include "core/emulator.h"
+#include "core/scheduler.h"
 
-void CPU::Cycle()
+uint8_t CPUBase::PackFlags(const State& state)
 {
-  Fetch();
-  Execute();
-}
-
-void CPU::Fetch()
-{
-  instruction_ = Read(PC_);
-}
+  if (!(state.flags & kLazyFlags))
+  {
+    return state.flags;
+  }
 
-void CPU::Execute()
-{
-  if (is_ALU(instruction_)) ALU();
-  else if (is_HALT(instruction_)) HALT();
-  else if (is_LOAD(instruction_)) LOAD();
-  else if (is_LOADI(instruction_)) LOADI();
-  else if (is_STORE(instruction_)) STORE();
-  else if (is_STOREI(instruction_)) STOREI();
-  else if (is_CALL(instruction_)) CALL();
-  else if (is_JMP(instruction_)) JMP();
-  else if (is_MOVI(instruction_)) MOVI();
-  else if (is_MOV(instruction_)) MOV();
-  else NOP();
-}
+  uint16_t result = state.alu_result;
 
-void CPU::HALT()
-{
-  ++PC_;
-  bus_->StopClock();
+  return ((result >> 8) & 0x1) << static_cast<int>(Flag::kCY) |
+         ((result & 0xFF) == 0) << static_cast<int>(Flag::kZ) |
+         ((result >> 7) & 0x1) << static_cast<int>(Flag::kS);
 }
 
-void CPU::NOP()
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::Cycle()
 {
-  ++PC_;
-}
+  if (Break())
+  {
+    bus_->StopClock();
+    return;
+  }
 
-void CPU::LOAD()
-{
-  uint8_t G = (instruction_ & 0x0700) >> 8;
-  uint8_t P = instruction_ & 0x0007;
+  const DecodedInstruction& op = Fetch();
+  hooks_.OnExecute(state_.registers[kPC], op);
+  Execute(op);
+}
+
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::Run(uint64_t budget)
+{
+  uint64_t executed = 0;
+  const DecodedInstruction* op;
+
+#if defined(__GNUC__)
+  // Handler labels must follow the order of DecodedInstruction::Handler.
+  static void* const kHandlers[] = {
+    &&exec_HALT, &&exec_NOP, &&exec_LOAD, &&exec_LOADI, &&exec_STORE,
+    &&exec_STOREI, &&exec_CALL, &&exec_JMP, &&exec_MOVI, &&exec_MOV,
+    &&exec_BinaryALU, &&exec_BinaryALU, &&exec_BinaryALU, &&exec_BinaryALU,
+    &&exec_BinaryALU, &&exec_BinaryALU, &&exec_BinaryALU,
+    &&exec_UnaryALU, &&exec_UnaryALU, &&exec_UnaryALU, &&exec_UnaryALU
+  };
+
+  // Each handler jumps straight to the next one, so there is no central loop
+  // and no stopped check between instructions.
+#define DISPATCH()                                      \
+  do                                                    \
+  {                                                     \
+    if (executed == budget) return executed;            \
+    if (Break()) goto stop;                             \
+    ++executed;                                         \
+    op = &Fetch();                                      \
+    hooks_.OnExecute(state_.registers[kPC], *op);       \
+    goto *kHandlers[static_cast<uint8_t>(op->handler)]; \
+  } while (0)
+
+  DISPATCH();
+
+exec_HALT:
+  HALT();
+  return executed;
+exec_NOP:
+  NOP();
+  DISPATCH();
+exec_LOAD:
+  LOAD(*op);
+  DISPATCH();
+exec_LOADI:
+  LOADI(*op);
+  DISPATCH();
+exec_STORE:
+  STORE(*op);
+  DISPATCH();
+exec_STOREI:
+  STOREI(*op);
+  DISPATCH();
+exec_CALL:
+  CALL(*op);
+  DISPATCH();
+exec_JMP:
+  JMP(*op);
+  DISPATCH();
+exec_MOVI:
+  MOVI(*op);
+  DISPATCH();
+exec_MOV:
+  MOV(*op);
+  DISPATCH();
+exec_BinaryALU:
+  BinaryALU(*op);
+  DISPATCH();
+exec_UnaryALU:
+  UnaryAlU(*op);
+  DISPATCH();
+
+#undef DISPATCH
+#else
+  while (executed < budget)
+  {
+    if (Break()) goto stop;
 
-  ++PC_;
+    ++executed;
+    op = &Fetch();
+    hooks_.OnExecute(state_.registers[kPC], *op);
+    Execute(*op);
 
-  if (IsAddressRegister(P))
-  {
-    SetRegister(G, Read(GetRegister(P)) & 0x00FF);
+    if (op->handler == DecodedInstruction::Handler::kHALT) break;
   }
-}
 
-void CPU::LOADI()
-{
-  uint8_t G = (instruction_ & 0x0700) >> 8;
-  uint8_t Imm = instruction_ & 0x00FF;
+  return executed;
+#endif
 
-  ++PC_;
-
-  SetRegister(G, Read(Imm));
+stop:
+  bus_->StopClock();
+  return executed;
 }
 
-void CPU::STORE()
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::RunBlocks(uint64_t budget)
 {
-  uint8_t G = (instruction_ & 0x0700) >> 8;
-  uint8_t P = instruction_ & 0x0007;
+  // Blocks skip the per-instruction hooks.
+  if (HookPolicy::kEnabled) return Run(budget);
 
-  ++PC_;
+  uint64_t executed = 0;
+  Block* block = &bus_->FetchBlock(state_.registers[kPC]);
 
-  if (IsAddressRegister(P))
+  for (;;)
   {
-    Write(GetRegister(P), GetRegister(G));
-  }
-}
+    if (block->loop)
+    {
+      uint64_t skipped = SkipLoop(*block->loop, budget - executed);
 
-void CPU::STOREI()
-{
-  uint8_t G = (instruction_ & 0x0700) >> 8;
-  uint8_t Imm  = instruction_ & 0x00FF;
+      if (skipped)
+      {
+        executed += skipped;
+        block = &NextBlock(*block);
+        continue;
+      }
+    }
 
-  ++PC_;
-  Write(Imm, GetRegister(G));
-}
+    if (budget - executed < block->instructions.size()) break;
 
-void CPU::CALL()
-{
-  uint8_t cond = (instruction_ & 0x7000) >> 12;
-  uint8_t Imm = instruction_ & 0x00FF;
+    for (const DecodedInstruction& op : block->instructions)
+    {
+      Execute(op);
+    }
 
-  if (CheckCondition(cond))
-  {
-    SetRegister(kL, PC_ + 1);
-    SetRegister(kPC, Imm);
+    const DecodedInstruction& last = block->instructions.back();
+
+    state_.instruction = last.instruction;
+    executed += block->instructions.size();
+
+    // HALT can only be the last instruction of a block.
+    if (last.handler == DecodedInstruction::Handler::kHALT) return executed;
+
+    block = &NextBlock(*block);
   }
-  else
+
+  // The budget ends inside the block, so finish it one instruction at a time.
+  for (const DecodedInstruction& op : block->instructions)
   {
-    ++PC_;
+    if (executed == budget) break;
+
+    state_.instruction = op.instruction;
+    Execute(op);
+    ++executed;
   }
+
+  return executed;
 }
 
-void CPU::JMP()
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::RunMemoized(uint64_t budget)
 {
-  uint8_t cond = (instruction_ & 0x7000) >> 12;
-  uint8_t Imm = instruction_ & 0x00FF;
+  if (HookPolicy::kEnabled) return Run(budget);
+
+  uint64_t executed = 0;
+  Block* block = &bus_->FetchBlock(state_.registers[kPC]);
 
-  if (CheckCondition(cond))
+  for (;;)
   {
-    SetRegister(kPC, Imm);
+    if (block->loop)
+    {
+      uint64_t skipped = SkipLoop(*block->loop, budget - executed);
+
+      if (skipped)
+      {
+        executed += skipped;
+        block = &NextBlock(*block);
+        continue;
+      }
+    }
+
+    if (budget - executed < block->instructions.size()) break;
+
+    const DecodedInstruction& last = block->instructions.back();
+    uint64_t key = SummaryKey(*block);
+    auto found = block->summaries.find(key);
+
+    if (found != block->summaries.end())
+    {
+      const BlockSummary& summary = found->second;
+
+      for (int code = kA; code <= kPC; ++code)
+      {
+        if (block->written >> code & 0x1)
+        {
+          state_.registers[code] = summary.registers[code];
+        }
+      }
+
+      if (block->writes_flags) SetResult(summary.alu_result);
+    }
+    else
+    {
+      for (const DecodedInstruction& op : block->instructions)
+      {
+        Execute(op);
+      }
+
+      if (block->summaries.size() < BlockCache::kMaxSummaries)
+      {
+        BlockSummary& summary = block->summaries[key];
+        memcpy(summary.registers, state_.registers, sizeof(summary.registers));
+        summary.alu_result = state_.alu_result;
+      }
+    }
+
+    state_.instruction = last.instruction;
+    executed += block->instructions.size();
+
+    // A replayed HALT must stop the clock as well.
+    if (last.handler == DecodedInstruction::Handler::kHALT)
+    {
+      bus_->StopClock();
+      return executed;
+    }
+
+    block = &NextBlock(*block);
   }
-  else
+
+  // The budget ends inside the block, so finish it one instruction at a time.
+  for (const DecodedInstruction& op : block->instructions)
   {
-    ++PC_;
+    if (executed == budget) break;
+
+    state_.instruction = op.instruction;
+    Execute(op);
+    ++executed;
   }
+
+  return executed;
 }
 
-void CPU::MOVI()
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::RunNative(uint64_t budget)
 {
-  uint8_t cond = (instruction_ & 0x7000) >> 12;
-  uint8_t Gd = (instruction_ & 0x0700) >> 8;
-  uint8_t Imm = instruction_ & 0x00FF;
+  if (!JIT::Supported() || HookPolicy::kEnabled)
+  {
+    return Run(budget);
+  }
 
-  ++PC_;
+  uint64_t executed = 0;
 
-  if (CheckCondition(cond))
+  for (;;)
   {
-    SetRegister(Gd, Imm);
-  }
-}
+    JIT::State state;
 
-void CPU::MOV()
-{
-  uint8_t Gd = (instruction_ & 0x0700) >> 8;
-  uint8_t Gs = (instruction_ & 0x0070) >> 4;
+    memcpy(state.registers, state_.registers, sizeof(state.registers));
 
-  ++PC_;
-  SetRegister(Gd, GetRegister(Gs));
-}
+    state.sign = GetFlag(Flag::kS);
+    state.zero = GetFlag(Flag::kZ);
+    state.carry = GetFlag(Flag::kCY);
+    state.instruction = state_.instruction;
+    state.budget = budget - executed;
 
-void CPU::ALU()
-{
-  bool bIsUnaryALU = (instruction_ & 0x7800) == 0x7800;
+    if (!bus_->ExecuteNative(state))
+    {
+      return executed + Run(budget - executed);
+    }
+
+    memcpy(state_.registers, state.registers, sizeof(state_.registers));
+
+    SetFlag(Flag::kS, state.sign);
+    SetFlag(Flag::kZ, state.zero);
+    SetFlag(Flag::kCY, state.carry);
+    state_.instruction = state.instruction;
+
+    executed = budget - state.budget;
 
-  ++PC_;
+    if (state.halted)
+    {
+      bus_->StopClock();
+      return executed;
+    }
 
-  if (bIsUnaryALU) UnaryAlU();
-  else BinaryALU();
+    // Native code returns before counting loops and input switch words.
+    const Block& block = bus_->FetchBlock(state_.registers[kPC]);
+    uint64_t skipped = block.loop ? SkipLoop(*block.loop, state.budget) : 0;
+
+    if (!skipped && IsInputSwitch(state_.registers[kPC]) && state.budget)
+    {
+      skipped = Run(1);
+      if (bus_->Stopped()) return executed + skipped;
+    }
+
+    if (!skipped) break;
+
+    executed += skipped;
+  }
+
+  // The rest of the budget is shorter than the next straight-line run, or the
+  // loop at PC does not exit within it.
+  return executed + Run(budget - executed);
 }
 
-void CPU::BinaryALU()
+template <class BusType, class HookPolicy>
+Block& BasicCPU<BusType, HookPolicy>::NextBlock(Block& block)
 {
-  uint8_t code = (instruction_ & 0x3800) >> 11;
-  uint8_t Gd = (instruction_ & 0x0700) >> 8;
-  uint8_t Gs1 = (instruction_ & 0x0070) >> 4;
-  uint8_t Op2 = (instruction_ & 0x0007);
-  bool r = (instruction_ & 0x0008) >> 3;
-  bool i = (instruction_ & 0x0080) >> 7;
-
-  uint8_t res;
-  Gs1 = GetRegister(Gs1);
-  if (!i) Op2 = GetRegister(Op2);
-  switch(code)
+  for (Block* successor : block.successors)
   {
-    case 0b000: res = ADC(Gs1, Op2); break;
-    case 0b001: res = ADD(Gs1, Op2); break;
-    case 0b010: res = SBC(Gs1, Op2); break;
-    case 0b011: res = SUB(Gs1, Op2); break;
-    case 0b100: res = AND(Gs1, Op2); break;
-    case 0b101: res = OR(Gs1, Op2); break;
-    case 0b110: res = XOR(Gs1, Op2); break;
+    if (successor && successor->entry == state_.registers[kPC]) return *successor;
   }
 
-  if (r) SetRegister(Gd, res);
+  // Keep the most recent successor in the first slot.
+  Block& next = bus_->FetchBlock(state_.registers[kPC]);
+  block.successors[1] = block.successors[0];
+  block.successors[0] = &next;
+
+  return next;
 }
 
-void CPU::UnaryAlU()
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::SummaryKey(const Block& block) const
 {
-  uint8_t code = (instruction_ & 0x0006) >> 1;
-  uint8_t Gd = (instruction_ & 0x0700) >> 8;
-  uint8_t Gs = (instruction_ & 0x0070) >> 4;
-  bool r = (instruction_ & 0x0008) >> 3;
-
-  uint8_t res;
-  Gs = GetRegister(Gs);
-  switch (code)
+  // Seven registers and three flags fit in 59 bits.
+  uint64_t key = block.flags_live_in ? PackFlags(state_) : 0;
+
+  for (uint8_t code : block.live_in)
   {
-    case 0b00: res = NOT(Gs); break;
-    case 0b01: res = ROR(Gs); break;
-    case 0b10: res = SHR(Gs); break;
-    case 0b11: res = RCR(Gs); break;
+    key |= static_cast<uint64_t>(state_.registers[code]) << (code * 8 + 3);
   }
 
-  if (r) SetRegister(Gd, res);
+  return key;
 }
 
-uint8_t CPU::ADC(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+uint64_t BasicCPU<BusType, HookPolicy>::SkipLoop(const CountingLoop& loop,
+                                                 uint64_t budget)
 {
-  uint8_t res = (Gs1 + Op2 + GetFlag(Flag::kCY)) & 0xFF;
+  uint8_t* r = state_.registers;
+  const CountingLoop::Exit& exit = loop.GetExit(r[loop.counter.Gs],
+                                                GetFlag(Flag::kCY));
+  uint64_t executed = static_cast<uint64_t>(exit.iterations) * loop.size;
 
-  SetFlag(Flag::kCY, (Gs1 + Op2 + GetFlag(Flag::kCY)) >> 8);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  if (!exit.iterations || executed > budget) return 0;
 
-  return res;
-}
+  // Registers wrap around, so the iteration count is only needed modulo 256.
+  uint8_t n = exit.iterations;
 
-uint8_t CPU::ADD(uint8_t Gs1, uint8_t Op2)
-{
-  uint8_t res = (Gs1 + Op2) & 0xFF;
+  for (const CountingLoop::Accumulator& accumulator : loop.accumulators)
+  {
+    uint8_t operand = accumulator.immediate ? accumulator.operand :
+                                              r[accumulator.operand];
+
+    switch (accumulator.handler)
+    {
+      case DecodedInstruction::Handler::kADD:
+        r[accumulator.code] += n * operand;
+        break;
+      case DecodedInstruction::Handler::kSUB:
+        r[accumulator.code] -= n * operand;
+        break;
+      default:
+        if (n & 0x1) r[accumulator.code] ^= operand;
+        break;
+    }
+  }
+
+  uint8_t counter = SetResult(exit.result);
+  if (loop.counter.WritesResult()) r[loop.counter.Gd] = counter;
 
-  SetFlag(Flag::kCY, (Gs1 + Op2) >> 8);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  r[kPC] = loop.entry + loop.size;
+  state_.instruction = loop.jump;
 
-  return res;
+  return executed;
 }
 
-uint8_t CPU::SBC(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+const DecodedInstruction& BasicCPU<BusType, HookPolicy>::Fetch()
 {
-  uint8_t res = (Gs1 - Op2 - GetFlag(Flag::kCY)) & 0xFF;
-
-  SetFlag(Flag::kCY, ((Gs1 - Op2 - GetFlag(Flag::kCY)) >> 8) & 0x1);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  const DecodedInstruction& op = bus_->Fetch(state_.registers[kPC]);
+  state_.instruction = op.instruction;
 
-  return res;
+  return op;
 }
 
-uint8_t CPU::SUB(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::Execute(const DecodedInstruction& op)
 {
-  uint8_t res = (Gs1 - Op2) & 0xFF;
+  typedef DecodedInstruction::Handler Handler;
 
-  SetFlag(Flag::kCY, ((Gs1 - Op2) >> 8) & 0x1);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  switch (op.handler)
+  {
+    case Handler::kHALT: HALT(); break;
+    case Handler::kNOP: NOP(); break;
+    case Handler::kLOAD: LOAD(op); break;
+    case Handler::kLOADI: LOADI(op); break;
+    case Handler::kSTORE: STORE(op); break;
+    case Handler::kSTOREI: STOREI(op); break;
+    case Handler::kCALL: CALL(op); break;
+    case Handler::kJMP: JMP(op); break;
+    case Handler::kMOVI: MOVI(op); break;
+    case Handler::kMOV: MOV(op); break;
+    case Handler::kADC: case Handler::kADD: case Handler::kSBC:
+    case Handler::kSUB: case Handler::kAND: case Handler::kOR:
+    case Handler::kXOR: BinaryALU(op); break;
+    case Handler::kNOT: case Handler::kROR: case Handler::kSHR:
+    case Handler::kRCR: UnaryAlU(op); break;
+  }
+}
 
-  return res;
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::HALT()
+{
+  ++state_.registers[kPC];
+  bus_->StopClock();
 }
 
-uint8_t CPU::AND(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::NOP()
 {
-  uint8_t res = Gs1 & Op2;
+  ++state_.registers[kPC];
+}
 
-  SetFlag(Flag::kCY, 0);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::LOAD(const DecodedInstruction& op)
+{
+  ++state_.registers[kPC];
 
-  return res;
+  if (IsAddressRegister(op.Gs))
+  {
+    SetRegister(op.Gd, Read(GetRegister(op.Gs)) & 0x00FF);
+  }
 }
 
-uint8_t CPU::OR(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::LOADI(const DecodedInstruction& op)
 {
-  uint8_t res = Gs1 | Op2;
+  ++state_.registers[kPC];
 
-  SetFlag(Flag::kCY, 0);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
-
-  return res;
+  SetRegister(op.Gd, Read(op.Op2));
 }
 
-uint8_t CPU::XOR(uint8_t Gs1, uint8_t Op2)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::STORE(const DecodedInstruction& op)
 {
-  uint8_t res = Gs1 ^ Op2;
-
-  SetFlag(Flag::kCY, 0);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  ++state_.registers[kPC];
 
-  return res;
+  if (IsAddressRegister(op.Gs))
+  {
+    Write(GetRegister(op.Gs), GetRegister(op.Gd));
+  }
 }
 
-uint8_t CPU::NOT(uint8_t Gs)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::STOREI(const DecodedInstruction& op)
 {
-  uint8_t res = ~Gs;
+  ++state_.registers[kPC];
+  Write(op.Op2, GetRegister(op.Gd));
+}
 
-  SetFlag(Flag::kCY, 0);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::CALL(const DecodedInstruction& op)
+{
+  if (CheckCondition(op.cond))
+  {
+    SetRegister(kL, state_.registers[kPC] + 1);
+    SetRegister(kPC, op.Op2);
+  }
+  else
+  {
+    ++state_.registers[kPC];
+  }
+}
 
-  return res;
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::JMP(const DecodedInstruction& op)
+{
+  if (CheckCondition(op.cond))
+  {
+    SetRegister(kPC, op.Op2);
+  }
+  else
+  {
+    ++state_.registers[kPC];
+  }
 }
 
-uint8_t CPU::ROR(uint8_t Gs)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::MOVI(const DecodedInstruction& op)
 {
-  uint8_t res = Gs >> 1;
-  res |= Gs << 7;
+  ++state_.registers[kPC];
 
-  SetFlag(Flag::kCY, 0);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  if (CheckCondition(op.cond))
+  {
+    SetRegister(op.Gd, op.Op2);
+  }
+}
 
-  return res;
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::MOV(const DecodedInstruction& op)
+{
+  ++state_.registers[kPC];
+  SetRegister(op.Gd, GetRegister(op.Gs));
 }
 
-uint8_t CPU::SHR(uint8_t Gs)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::BinaryALU(const DecodedInstruction& op)
 {
-  uint8_t res = Gs >> 1;
+  ++state_.registers[kPC];
 
-  SetFlag(Flag::kCY, Gs & 0x1);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  uint8_t Gs1 = GetRegister(op.Gs);
+  uint8_t Op2 = op.HasImmediate() ? op.Op2 : GetRegister(op.Op2);
+  uint8_t res = SetResult(lookup_binary_alu(op.handler, GetFlag(Flag::kCY),
+                                            Gs1, Op2));
 
-  return res;
+  if (op.WritesResult()) SetRegister(op.Gd, res);
 }
 
-uint8_t CPU::RCR(uint8_t Gs)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::UnaryAlU(const DecodedInstruction& op)
 {
-  uint8_t res = Gs >> 1;
-  res |= GetFlag(Flag::kCY) << 7;
+  ++state_.registers[kPC];
 
-  SetFlag(Flag::kCY, Gs & 0x1);
-  SetFlag(Flag::kZ, res == 0);
-  SetFlag(Flag::kS, res >> 7);
+  uint8_t res = SetResult(lookup_unary_alu(op.handler, GetFlag(Flag::kCY),
+                                           GetRegister(op.Gs)));
 
-  return res;
+  if (op.WritesResult()) SetRegister(op.Gd, res);
 }
 
-void CPU::Reset()
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::Reset()
 {
-  A_ = 0x00;
-  B_ = 0x00;
-  C_ = 0x00;
-  D_ = 0x00;
-  M_ = 0x00;
-  S_ = 0x00;
-  L_ = 0x00;
-  PC_ = 0x00;
-
-  sign_ = false;
-  zero_ = false;
-  carry_ = false;
-
-  instruction_ = 0x0000;
-
-  halted_ = false;
+  state_ = State();
+  at_breakpoint_ = false;
 }
 
-uint16_t CPU::Read(uint8_t addr)
+template <class BusType, class HookPolicy>
+uint16_t BasicCPU<BusType, HookPolicy>::Read(uint8_t addr)
 {
   return bus_->Read(addr);
 }
 
-void CPU::Write(uint8_t addr, uint8_t value)
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::Write(uint8_t addr, uint8_t value)
 {
   return bus_->Write(addr, value);
 }
 
-bool CPU::CheckCondition(uint8_t cond)
+template <class BusType, class HookPolicy>
+bool BasicCPU<BusType, HookPolicy>::CheckCondition(uint8_t cond)
 {
   switch (cond)
   {
@@ -363,54 +583,17 @@ bool CPU::CheckCondition(uint8_t cond)
   }
 }
 
-uint8_t CPU::GetRegister(uint8_t code) const
+template <class BusType, class HookPolicy>
+void BasicCPU<BusType, HookPolicy>::SetFlag(Flag flag, bool value)
 {
-  switch (RegisterCode(code & 0x07))
-  {
-    case kA: return A_;
-    case kB: return B_;
-    case kC: return C_;
-    case kD: return D_;
-    case kM: return M_;
-    case kS: return S_;
-    case kL: return L_;
-    case kPC: default: return PC_;
-  }
+  // A single flag can't be expressed as an ALU result, so all three are
+  // evaluated first.
+  uint8_t bit = 1 << static_cast<int>(flag);
+  state_.flags = (PackFlags(state_) & ~bit) | (value ? bit : 0);
 }
 
-void CPU::SetRegister(uint8_t code, uint8_t value)
-{
-  switch (RegisterCode(code & 0x07))
-  {
-    case kA: A_ = value; break;
-    case kB: B_ = value; break;
-    case kC: C_ = value; break;
-    case kD: D_ = value; break;
-    case kM: M_ = value; break;
-    case kS: S_ = value; break;
-    case kL: L_ = value; break;
-    case kPC: default: PC_ = value; break;
-  }
-}
+template class BasicCPU<BasicBus<NoHooks>, NoHooks>;
+template class BasicCPU<BasicBus<DebugHooks>, DebugHooks>;
 
-bool CPU::GetFlag(Flag flag) const
-{
-  switch(flag)
-  {
-    case Flag::kCY: return carry_;
-    case Flag::kZ: return zero_;
-    case Flag::kS: return sign_;
-    default: return false;
-  }
-}
-
-void CPU::SetFlag(Flag flag, bool value)
-{
-  switch(flag)
-  {
-    case Flag::kCY: carry_ = value; break;
-    case Flag::kZ: zero_ = value; break;
-    case Flag::kS: sign_ = value; break;
-    default: break;
-  }
-}
+// Scheduler machines only use the threaded interpreter.
+template uint64_t BasicCPU<InstanceBus, NoHooks>::Run(uint64_t budget);
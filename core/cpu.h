@@ -1,14 +1,13 @@
 #pragma once
 #include <memory>
+#include <type_traits>
 
-#include "core/instructionset.h"
+#include "core/blockcache.h"
+#include "core/hooks.h"
 
-// Forward declaration to prevent circular inclusion. This is necessary because
-// the Bus class and the CPU class have pointers to each other.
-
-class Bus;
-
-class CPU {
+// Register codes and flags, shared by every instantiation of BasicCPU.
+class CPUBase
+{
   public:
     enum RegisterCode : uint8_t
     {
@@ -37,94 +36,206 @@ class CPU {
       kS
     };
 
+    // Complete architectural state. It is trivially copyable, so a machine is
+    // copied or snapshotted with a single memcpy.
+    struct State
+    {
+      // Indexed by RegisterCode
+      uint8_t registers[8];
+
+      // Instruction register
+      uint16_t instruction;
+
+      // Last ALU result with the carry-out in bit 8 (see core/alu.h)
+      uint16_t alu_result;
+
+      // Flag values at bit positions given by Flag. If kLazyFlags is set, the
+      // flags are derived from alu_result instead.
+      uint8_t flags;
+
+      bool halted;
+    };
+
+    static const uint8_t kLazyFlags = 0x80;
+
+  public:
+    // Returns the flags of state packed as in State::flags, without
+    // kLazyFlags.
+    static uint8_t PackFlags(const State& state);
+};
+
+static_assert(std::is_trivially_copyable<CPUBase::State>::value,
+              "CPU state must be copyable with memcpy");
+
+// CPU parameterised on the bus it is connected to and on a hook policy (see
+// core/hooks.h). Bus calls are resolved at compile time, so memory reads are
+// inlined into the interpreter loops, and disabled hooks cost nothing.
+template <class BusType, class HookPolicy>
+class BasicCPU : public CPUBase
+{
   public:
-    CPU(Bus* bus) : bus_(bus)
+    BasicCPU(BusType* bus) : bus_(bus)
     {
     };
 
+    // The bus owns the CPU, so it reconnects it after the bus is moved.
+    void ConnectBus(BusType* bus) { bus_ = bus; }
+
   public:
-    // Performs one instruction cycle.
+    // Performs one instruction cycle. Stops the clock instead if there is a
+    // breakpoint at PC.
     void Cycle();
 
-    // Sets all registers to 0 and halted_ to false.
+    // Executes instructions until HALT, a breakpoint, or until budget
+    // instructions have been executed, without returning to the bus in
+    // between. Returns the number of executed instructions.
+    uint64_t Run(uint64_t budget);
+
+    // Same as Run(), but executes whole blocks from the bus block cache and
+    // follows their successor links instead of fetching every instruction.
+    // Counting loops are skipped to their exit. Falls back to Run() if the
+    // hook policy is enabled.
+    uint64_t RunBlocks(uint64_t budget);
+
+    // Same as Run(), but executes the native translation of the program,
+    // skips counting loops as RunBlocks() does and finishes with the
+    // interpreter what is left of the budget. Falls back to Run() if the host
+    // is not supported or the hook policy is enabled.
+    uint64_t RunNative(uint64_t budget);
+
+    // Same as RunBlocks(), but memoises the effect of every block for the
+    // values of its live-in registers and flags, and replays it when the
+    // block is entered with the same values again. Pays off when many runs
+    // pass through the same intermediate states. Falls back to Run() if the
+    // hook policy is enabled.
+    uint64_t RunMemoized(uint64_t budget);
+
+    // Sets all registers to 0 and halted to false.
     void Reset();
 
-    uint8_t GetRegister(uint8_t code) const;
-    void SetRegister(uint8_t code, uint8_t value);
-    bool GetFlag(Flag flag) const;
+    // Returns true if the clock was stopped at a breakpoint that has not been
+    // passed since.
+    bool AtBreakpoint() const { return at_breakpoint_; }
+
+    uint8_t GetRegister(uint8_t code) const
+    {
+      return state_.registers[code & 0x07];
+    }
+
+    void SetRegister(uint8_t code, uint8_t value)
+    {
+      state_.registers[code & 0x07] = value;
+    }
+
+    bool GetFlag(Flag flag) const
+    {
+      return (PackFlags(state_) >> static_cast<int>(flag)) & 0x1;
+    }
+
     void SetFlag(Flag flag, bool value);
 
+    const State& GetState() const { return state_; }
+    void SetState(const State& state) { state_ = state; }
+
     uint16_t Read(uint8_t addr);
     void Write(uint8_t addr, uint8_t value);
 
     bool Halted() const
     {
-      return halted_;
+      return state_.halted;
     };
 
     uint16_t GetInstructionRegister() const
     {
-      return instruction_;
+      return state_.instruction;
     }
 
+    HookPolicy& GetHooks() { return hooks_; }
+    const HookPolicy& GetHooks() const { return hooks_; }
+
   private:
-    // Fetches an instruction.
-    void Fetch();
+    // Returns true if execution must stop at a breakpoint before the
+    // instruction at PC. The breakpoint it last stopped at is passed.
+    bool Break()
+    {
+      if (!HookPolicy::kEnabled) return false;
+
+      if (at_breakpoint_)
+      {
+        at_breakpoint_ = false;
+        return false;
+      }
+
+      at_breakpoint_ = hooks_.Break(state_.registers[kPC]);
+      return at_breakpoint_;
+    }
+
+    // Fetches a predecoded instruction.
+    const DecodedInstruction& Fetch();
+
+    // Executes a predecoded instruction.
+    void Execute(const DecodedInstruction& op);
+
+    // Returns the block to execute after block, i.e. the one at PC.
+    Block& NextBlock(Block& block);
+
+    // Returns the live-in values of block packed into a summary key.
+    uint64_t SummaryKey(const Block& block) const;
 
-    // Decodes and executes an instruction.
-    void Execute();
+    // Runs loop, which starts at PC, to its exit at once. Returns the number
+    // of instructions that took, or 0 if the loop never exits or does not
+    // exit within budget, in which case nothing is executed.
+    uint64_t SkipLoop(const CountingLoop& loop, uint64_t budget);
 
     void HALT();
     void NOP();
-    void LOAD();
-    void LOADI();
-    void STORE();
-    void STOREI();
-    void CALL();
-    void JMP();
-    void MOVI();
-    void MOV();
-    void ALU();
-
-    uint8_t ADC(uint8_t Gs1, uint8_t Op2);
-    uint8_t ADD(uint8_t Gs1, uint8_t Op2);
-    uint8_t SBC(uint8_t Gs1, uint8_t Op2);
-    uint8_t SUB(uint8_t Gs1, uint8_t Op2);
-    uint8_t AND(uint8_t Gs1, uint8_t Op2);
-    uint8_t OR(uint8_t Gs1, uint8_t Op2);
-    uint8_t XOR(uint8_t Gs1, uint8_t Op2);
-    uint8_t NOT(uint8_t Gs);
-    uint8_t ROR(uint8_t Gs);
-    uint8_t SHR(uint8_t Gs);
-    uint8_t RCR(uint8_t Gs);
-
-    void BinaryALU();
-    void UnaryAlU();
+    void LOAD(const DecodedInstruction& op);
+    void LOADI(const DecodedInstruction& op);
+    void STORE(const DecodedInstruction& op);
+    void STOREI(const DecodedInstruction& op);
+    void CALL(const DecodedInstruction& op);
+    void JMP(const DecodedInstruction& op);
+    void MOVI(const DecodedInstruction& op);
+    void MOV(const DecodedInstruction& op);
+
+    void BinaryALU(const DecodedInstruction& op);
+    void UnaryAlU(const DecodedInstruction& op);
 
     bool CheckCondition(uint8_t cond);
 
+    // Records the result of an ALU operation (see core/alu.h) and returns its
+    // low byte. The flags are derived from it when they are read.
+    uint8_t SetResult(uint16_t result)
+    {
+      state_.alu_result = result;
+      state_.flags = kLazyFlags;
+
+      return result & 0xFF;
+    }
+
+    // Returns true if addr is an input switch word.
+    static bool IsInputSwitch(uint8_t addr)
+    {
+      return addr >= ROM::kProgramDataSize &&
+             addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize;
+    }
+
     // Returns true if register is one of the memory pointers (M, S, L or PC).
     bool IsAddressRegister(uint8_t code) { return code > 4; };
 
   private:
-    // Bus has a smart pointer to the CPU, so no need to free bus_.
-    Bus* bus_;
-
-    // Instruction register
-    uint16_t instruction_ = 0x0000;
-
-    uint8_t A_ = 0x00;
-    uint8_t B_ = 0x00;
-    uint8_t C_ = 0x00;
-    uint8_t D_ = 0x00;
-    uint8_t M_ = 0x00;
-    uint8_t S_ = 0x00;
-    uint8_t L_ = 0x00;
-    uint8_t PC_ = 0x00;
-
-    bool sign_ = false;
-    bool zero_ = false;
-    bool carry_ = false;
-
-    bool halted_ = false;
+    // Bus owns the CPU, so no need to free bus_.
+    BusType* bus_;
+
+    HookPolicy hooks_;
+    bool at_breakpoint_ = false;
+
+    State state_ = {};
 };
+
+// Forward declaration to prevent circular inclusion. This is necessary because
+// the bus contains the CPU and the CPU has a pointer to the bus.
+template <class HookPolicy>
+class BasicBus;
+
+typedef BasicCPU<BasicBus<DefaultHooks>, DefaultHooks> CPU;
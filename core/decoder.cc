@@ -0,0 +1,84 @@
+#include <array>
+
+#include "core/decoder.h"
+
+typedef std::array<uint8_t, 0x10000> DecodeTable;
+
+static const DecodeTable& get_decode_table();
+
+DecodedInstruction decode(uint16_t instruction)
+{
+  DecodedInstruction op;
+
+  op.instruction = instruction;
+
+  int index = lookup_instruction_format(instruction);
+  if (index == kUnknownInstruction)
+  {
+    op.handler = DecodedInstruction::Handler::kNOP;
+    return op;
+  }
+
+  const InstructionFormat& format = kInstructionSet[index];
+
+  op.handler = format.operation;
+  op.Gd = format.Gd.Extract(instruction);
+  op.Gs = format.Gs.Extract(instruction);
+  op.Op2 = format.Op2.Extract(instruction);
+  op.cond = format.cond.Extract(instruction);
+
+  if (format.r.Extract(instruction))
+  {
+    op.flags |= DecodedInstruction::kWriteResult;
+  }
+
+  if (format.i.Extract(instruction))
+  {
+    op.flags |= DecodedInstruction::kImmediate;
+  }
+
+  return op;
+}
+
+bool DecodedInstruction::ChangesControlFlow() const
+{
+  const uint8_t kPC = 0x07;
+
+  switch (handler)
+  {
+    case Handler::kHALT: case Handler::kCALL: case Handler::kJMP:
+      return true;
+    case Handler::kLOAD: case Handler::kLOADI: case Handler::kMOV:
+      return Gd == kPC;
+    case Handler::kNOP: case Handler::kSTORE: case Handler::kSTOREI:
+    case Handler::kMOVI:
+      return false;
+    default:
+      // ALU
+      return WritesResult() && Gd == kPC;
+  }
+}
+
+int lookup_instruction_format(uint16_t instruction)
+{
+  return get_decode_table()[instruction];
+}
+
+// Returns the index of the instruction format of every possible word. The
+// table is built on first use.
+static const DecodeTable& get_decode_table()
+{
+  static const DecodeTable table = []()
+  {
+    DecodeTable table;
+
+    for (int instruction = 0; instruction < 0x10000; ++instruction)
+    {
+      table[instruction] = find_instruction_format(instruction);
+    }
+
+    return table;
+  }();
+
+  return table;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+
+#include "core/instructionset.h"
+
+// Instruction with its operands already extracted. The ROM is immutable after
+// it is connected to the bus, so every word is decoded once and the CPU
+// executes these records instead of decoding raw words on each cycle.
+struct DecodedInstruction
+{
+  typedef Operation Handler;
+
+  enum Flags : uint8_t
+  {
+    // ALU result is written to Gd (otherwise only flags are updated).
+    kWriteResult = 0x01,
+
+    // Op2 holds an immediate value instead of a register code.
+    kImmediate = 0x02
+  };
+
+  // Raw word, kept for the instruction register.
+  uint16_t instruction = 0x0000;
+
+  Handler handler = Handler::kNOP;
+
+  // Destination register (G for LOAD/STORE).
+  uint8_t Gd = 0;
+
+  // Source register (Gs1 for binary ALU, P for LOAD/STORE).
+  uint8_t Gs = 0;
+
+  // Second ALU operand or 8-bit immediate.
+  uint8_t Op2 = 0;
+
+  uint8_t cond = 0;
+  uint8_t flags = 0;
+
+  bool WritesResult() const { return flags & kWriteResult; }
+  bool HasImmediate() const { return flags & kImmediate; }
+
+  // Returns true for JMP, CALL, HALT and any instruction that may write PC.
+  bool ChangesControlFlow() const;
+};
+
+// Decodes an instruction with a single lookup in a table generated from
+// kInstructionSet.
+DecodedInstruction decode(uint16_t instruction);
+
+// Returns the index in kInstructionSet of the instruction format, or
+// kUnknownInstruction.
+int lookup_instruction_format(uint16_t instruction);
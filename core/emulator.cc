@@ -5,37 +5,87 @@
 #include <arpa/inet.h>
 
 #include "core/emulator.h"
+#include "core/loopdetector.h"
 #include "utils/str.h"
 
-Emulator::Emulator(bool gui_enabled)
-    : gui_enabled_(gui_enabled)
+Emulator::Emulator(bool gui_enabled, Engine::Type engine)
+    : gui_enabled_(gui_enabled), engine_type_(engine),
+      engine_(Engine::Create(engine))
 {
 }
 
 Emulator::Emulator(const std::string& program_path,
-                   std::array<uint8_t, 2> input, bool gui_enabled)
-    : Emulator(gui_enabled)
+                   std::array<uint8_t, 2> input, bool gui_enabled,
+                   Engine::Type engine)
+    : Emulator(gui_enabled, engine)
 {
   Load(program_path);
   Input(input[0], input[1]);
 }
 
-void Emulator::Run()
+Emulator::Status Emulator::Run(uint64_t budget)
 {
-  while (!bus_.Stopped())
-  {
-    Step();
-  }
+  engine_->Resume();
+
+  uint64_t executed;
+  Status status = Run(*engine_, budget, executed);
 
   if (!gui_enabled_)
   {
     PrintDebugInfo();
   }
+
+  return status;
+}
+
+std::vector<Emulator::Result> Emulator::RunBatch(
+    const std::vector<std::array<uint8_t, 2>>& inputs, uint64_t budget)
+{
+  std::vector<Result> results(inputs.size());
+
+  for (size_t index = 0; index < inputs.size(); ++index)
+  {
+    Result& result = results[index];
+
+    engine_->Reset();
+    engine_->Input(inputs[index][0], inputs[index][1]);
+
+    result.status = Run(*engine_, budget, result.executed);
+    result.state = engine_->GetState();
+  }
+
+  return results;
+}
+
+Emulator::Status Emulator::Run(Engine& engine, uint64_t budget,
+                               uint64_t& executed)
+{
+  LoopDetector loops;
+  executed = 0;
+
+  while (!engine.Stopped())
+  {
+    if (executed == budget) return Status::kBudgetExhausted;
+
+    uint64_t quantum = budget - executed;
+    if (quantum > kRunQuantum) quantum = kRunQuantum;
+    uint64_t ran = engine.Run(quantum);
+    executed += ran;
+
+    // Only full quanta are sampled, so samples are equally spaced.
+    if (ran == quantum && !engine.Stopped() &&
+        loops.Check(engine.GetState()))
+    {
+      return Status::kLooped;
+    }
+  }
+
+  return Status::kHalted;
 }
 
 void Emulator::Debug()
 {
-  while (!bus_.Stopped())
+  while (!engine_->Stopped())
   {
     std::string command;
     while (command != "step" && command != "s")
@@ -69,9 +119,11 @@ void Emulator::Debug()
 
 void Emulator::Step()
 {
-  if (!bus_.Stopped())
+  engine_->Resume();
+
+  if (!engine_->Stopped())
   {
-    bus_.Cycle();
+    engine_->Step();
   }
   else
   {
@@ -81,10 +133,16 @@ void Emulator::Step()
 
 void Emulator::Reset()
 {
-  bus_.Reset();
+  engine_->Reset();
 }
 
 void Emulator::Load(const std::string& program_path)
+{
+  engine_->Load(ROM(ReadProgram(program_path)));
+}
+
+std::array<uint16_t, ROM::kProgramDataSize> Emulator::ReadProgram(
+    const std::string& program_path)
 {
   std::ifstream program(program_path, std::ios::in | std::ios::binary);
 
@@ -103,17 +161,22 @@ void Emulator::Load(const std::string& program_path)
     program_data[addr] = ntohs(op);
   }
 
-  bus_.ConnectROM(ROM(program_data));
+  return program_data;
+}
+
+void Emulator::Patch(uint8_t addr, uint16_t word)
+{
+  engine_->Patch(addr, word);
 }
 
 void Emulator::Input(uint8_t first, uint8_t second)
 {
-  bus_.Input(first, second);
+  engine_->Input(first, second);
 }
 
 void Emulator::Stop()
 {
-  bus_.StopClock();
+  engine_->Stop();
 }
 
 void Emulator::PrintDebugInfo() const
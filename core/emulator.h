@@ -1,14 +1,45 @@
 #pragma once
 #include <array>
+#include <vector>
 
-#include "core/bus.h"
+#include "core/engine.h"
 
 class Emulator
 {
   public:
-    Emulator(bool GUI_enabled = false);
+    // Why Run() returned
+    enum class Status
+    {
+      // HALT or Stop()
+      kHalted,
+
+      // The machine repeated a state, so it would never halt.
+      kLooped,
+
+      // The instruction budget ran out first.
+      kBudgetExhausted
+    };
+
+    // Outcome of one run of RunBatch()
+    struct Result
+    {
+      Status status;
+      CPU::State state;
+      uint64_t executed;
+    };
+
+    // Number of instructions Run() executes between checks for an external
+    // stop request or a repeated state.
+    static const uint64_t kRunQuantum = 1 << 16;
+
+    static const uint64_t kNoBudget = UINT64_MAX;
+
+  public:
+    Emulator(bool GUI_enabled = false,
+             Engine::Type engine = Engine::Type::kReference);
     Emulator(const std::string& program_path,
-             std::array<uint8_t, 2> input = {}, bool GUI_enabled = false);
+             std::array<uint8_t, 2> input = {}, bool GUI_enabled = false,
+             Engine::Type engine = Engine::Type::kReference);
 
     // Movable only
     Emulator(const Emulator&) = delete;
@@ -17,26 +48,67 @@ class Emulator
     Emulator& operator=(Emulator&&) = default;
 
   public:
-    // Executes the entire program.
-    void Run();
+    // Executes the program until it halts, until it is found to loop forever
+    // or until budget instructions have been executed. A breakpoint the
+    // machine is stopped at is passed, as by Step().
+    Status Run(uint64_t budget = kNoBudget);
+
+    // Runs the loaded program from reset for each of inputs, as Run() does
+    // with budget but without printing anything. Returns the results in the
+    // order of inputs and leaves the machine as the last run left it.
+    std::vector<Result> RunBatch(
+        const std::vector<std::array<uint8_t, 2>>& inputs,
+        uint64_t budget = kNoBudget);
+
+    // Same as Run() on an engine of its own, without printing anything.
+    // Executed receives the number of executed instructions.
+    static Status Run(Engine& engine, uint64_t budget, uint64_t& executed);
     void Debug();
 
-    // Performs one instruction.
+    // Performs one instruction, also when the machine is stopped at a
+    // breakpoint.
     void Step();
     void Stop();
     void Reset();
 
     void Load(const std::string& program_path);
+
+    // Returns the program in the file at program_path as Load() reads it.
+    static std::array<uint16_t, ROM::kProgramDataSize> ReadProgram(
+        const std::string& program_path);
+
+    // Replaces the program word at addr. The machine keeps its state, so it
+    // can be patched while paused in the middle of the program, between calls
+    // to Run() or Step(), but not during one of them.
+    void Patch(uint8_t addr, uint16_t word);
+
     void Input(uint8_t first, uint8_t second);
 
-    Bus::DebugInfo GetDebugInfo() const { return bus_.GetDebugInfo(); };
+    // Returns the state of the machine, which Restore() returns it to. The
+    // program is not part of it, so a snapshot taken before a Patch() or
+    // Load() restores the state only.
+    MachineSnapshot Snapshot() const { return engine_->Snapshot(); }
+    void Restore(const MachineSnapshot& snapshot)
+    {
+      engine_->Restore(snapshot);
+    }
+
+    Bus::DebugInfo GetDebugInfo() const { return engine_->GetDebugInfo(); };
     void PrintDebugInfo() const;
 
-    bool Stopped() const { return bus_.Stopped(); };
+    bool Stopped() const { return engine_->Stopped(); };
+
+    // See Engine::GetHooks().
+    DefaultHooks& GetHooks() { return engine_->GetHooks(); }
+
+    // Returns the engine chosen at construction. Step() and Debug() execute
+    // one instruction at a time with any engine.
+    Engine::Type GetEngine() const { return engine_type_; }
 
   private:
     // If GUI enabled, there is no need to print any information.
     bool gui_enabled_;
 
-    Bus bus_;
+    Engine::Type engine_type_;
+    std::unique_ptr<Engine> engine_;
 };
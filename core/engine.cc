@@ -0,0 +1,109 @@
+#include "core/engine.h"
+#include "core/jit.h"
+
+// Engine running the machine on a Bus. Subclasses choose how Run() executes
+// instructions.
+class BusEngine : public Engine
+{
+  public:
+    void Step() override { bus_.Cycle(); }
+
+    void Stop() override { bus_.StopClock(); }
+    bool Stopped() const override { return bus_.Stopped(); }
+
+    void Resume() override { bus_.Resume(); }
+
+    void Reset() override { bus_.Reset(); }
+
+    void Load(const ROM& rom) override { bus_.ConnectROM(rom); }
+
+    void Patch(uint8_t addr, uint16_t word) override
+    {
+      bus_.Patch(addr, word);
+    }
+
+    void Input(uint8_t first, uint8_t second) override
+    {
+      bus_.Input(first, second);
+    }
+
+    Bus::DebugInfo GetDebugInfo() const override
+    {
+      return bus_.GetDebugInfo();
+    }
+
+    CPU::State GetState() const override { return bus_.GetState(); }
+
+    DefaultHooks& GetHooks() override { return bus_.GetHooks(); }
+
+    MachineSnapshot Snapshot() const override { return bus_.Snapshot(); }
+
+    void Restore(const MachineSnapshot& snapshot) override
+    {
+      bus_.Restore(snapshot);
+    }
+
+  protected:
+    Bus bus_;
+};
+
+class ReferenceEngine : public BusEngine
+{
+  public:
+    uint64_t Run(uint64_t budget) override
+    {
+      uint64_t executed = 0;
+      for (; executed < budget && !bus_.Stopped(); ++executed)
+      {
+        bus_.Cycle();
+      }
+
+      return executed;
+    }
+};
+
+class ThreadedEngine : public BusEngine
+{
+  public:
+    uint64_t Run(uint64_t budget) override { return bus_.Run(budget); }
+};
+
+class BlockEngine : public BusEngine
+{
+  public:
+    uint64_t Run(uint64_t budget) override { return bus_.RunBlocks(budget); }
+};
+
+class MemoEngine : public BusEngine
+{
+  public:
+    uint64_t Run(uint64_t budget) override { return bus_.RunMemoized(budget); }
+};
+
+class NativeEngine : public BusEngine
+{
+  public:
+    uint64_t Run(uint64_t budget) override { return bus_.RunNative(budget); }
+};
+
+std::unique_ptr<Engine> Engine::Create(Type type)
+{
+  switch (type)
+  {
+    case Type::kThreaded:
+      return std::unique_ptr<Engine>(new ThreadedEngine());
+    case Type::kBlocks:
+      return std::unique_ptr<Engine>(new BlockEngine());
+    case Type::kMemo:
+      return std::unique_ptr<Engine>(new MemoEngine());
+    case Type::kNative:
+      return std::unique_ptr<Engine>(new NativeEngine());
+    case Type::kReference: default:
+      return std::unique_ptr<Engine>(new ReferenceEngine());
+  }
+}
+
+Engine::Type Engine::Fastest()
+{
+  return JIT::Supported() ? Type::kNative : Type::kThreaded;
+}
@@ -0,0 +1,76 @@
+#pragma once
+#include <memory>
+
+#include "core/bus.h"
+#include "core/rom.h"
+
+// Execution engine behind Emulator. Every engine runs the same machine, so
+// they differ only in speed and in what they support on a given host.
+class Engine
+{
+  public:
+    enum class Type
+    {
+      // One Bus::Cycle() per instruction
+      kReference,
+
+      // Computed-goto dispatch loop
+      kThreaded,
+
+      // Translated blocks of straight-line code
+      kBlocks,
+
+      // kBlocks replaying memoised block effects
+      kMemo,
+
+      // x86-64 translation of the program (kThreaded on other hosts)
+      kNative
+    };
+
+  public:
+    virtual ~Engine() = default;
+
+    // Creates an engine of type with an empty program.
+    static std::unique_ptr<Engine> Create(Type type);
+
+    // Returns the fastest engine available on this host.
+    static Type Fastest();
+
+  public:
+    // Executes up to budget instructions or until the machine stops. Returns
+    // the number of executed instructions.
+    virtual uint64_t Run(uint64_t budget) = 0;
+
+    // Performs one instruction.
+    virtual void Step() = 0;
+
+    virtual void Stop() = 0;
+    virtual bool Stopped() const = 0;
+
+    // See Bus::Resume().
+    virtual void Resume() = 0;
+
+    // Resets the CPU and restarts the clock.
+    virtual void Reset() = 0;
+
+    virtual void Load(const ROM& rom) = 0;
+
+    // Replaces one program word without reloading the program, between calls
+    // to Run() or Step() (see Bus::Patch()).
+    virtual void Patch(uint8_t addr, uint16_t word) = 0;
+
+    virtual void Input(uint8_t first, uint8_t second) = 0;
+
+    virtual Bus::DebugInfo GetDebugInfo() const = 0;
+
+    // Returns the CPU state. Cheaper than GetDebugInfo().
+    virtual CPU::State GetState() const = 0;
+
+    // Returns the hooks of the CPU. Breakpoints, tracing and profiling need a
+    // build with RELAY_DEBUG_HOOKS (see core/hooks.h).
+    virtual DefaultHooks& GetHooks() = 0;
+
+    // See Bus::Snapshot() and Bus::Restore().
+    virtual MachineSnapshot Snapshot() const = 0;
+    virtual void Restore(const MachineSnapshot& snapshot) = 0;
+};
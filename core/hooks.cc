@@ -0,0 +1,16 @@
+#include <iostream>
+
+#include "core/disassembler.h"
+#include "core/hooks.h"
+#include "utils/str.h"
+
+void DebugHooks::OnExecute(uint8_t pc, const DecodedInstruction& op)
+{
+  ++counts_[pc];
+
+  if (tracing_)
+  {
+    std::clog << "0x" << to_hex_string(pc, 2) << ": "
+              << disassemble(op.instruction) << "\n";
+  }
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <array>
+#include <bitset>
+#include <cstdint>
+
+#include "core/decoder.h"
+#include "core/rom.h"
+
+// Hook policies of BasicCPU. The CPU calls the hooks of its policy on every
+// instruction. They are resolved at compile time, so with NoHooks the calls
+// and their checks disappear from the interpreter loops entirely.
+
+// Production policy: every hook is empty.
+struct NoHooks
+{
+  // Whether the policy observes instructions. If it does, the block and
+  // native interpreters fall back to the threaded one, which calls the hooks.
+  static const bool kEnabled = false;
+
+  // Returns true if execution must stop before the instruction at pc.
+  bool Break(uint8_t) const { return false; }
+
+  // Called before the instruction at pc is executed.
+  void OnExecute(uint8_t, const DecodedInstruction&) {}
+};
+
+// Debugging policy with tracing, profiling, coverage and breakpoints.
+class DebugHooks
+{
+  public:
+    static const bool kEnabled = true;
+
+  public:
+    // Reaching a breakpoint stops the clock before the instruction executes.
+    // Bus::Resume() restarts it, and the instruction then executes without
+    // breaking again.
+    bool Break(uint8_t pc) const { return breakpoints_[pc]; }
+
+    void OnExecute(uint8_t pc, const DecodedInstruction& op);
+
+  public:
+    // Prints every executed instruction to std::clog.
+    void SetTracing(bool tracing) { tracing_ = tracing; }
+
+    void SetBreakpoint(uint8_t pc, bool enabled = true)
+    {
+      breakpoints_[pc] = enabled;
+    }
+
+    // Returns how many times the instruction at pc has been executed.
+    uint64_t GetExecutionCount(uint8_t pc) const { return counts_[pc]; }
+
+    // Returns true if the instruction at pc has been executed at least once.
+    bool Covered(uint8_t pc) const { return counts_[pc] != 0; }
+
+    // Clears the profile and the coverage.
+    void ResetCounts() { counts_.fill(0); }
+
+  private:
+    bool tracing_ = false;
+    std::bitset<ROM::kAddressSpaceSize> breakpoints_;
+    std::array<uint64_t, ROM::kAddressSpaceSize> counts_ = {};
+};
+
+// Hooks compiled into the emulator. Debugging builds define RELAY_DEBUG_HOOKS.
+#if defined(RELAY_DEBUG_HOOKS)
+typedef DebugHooks DefaultHooks;
+#else
+typedef NoHooks DefaultHooks;
+#endif
@@ -1,74 +1,195 @@
 #pragma once
 #include <cstdint>
 
-// Instruction codes without conditions and operands to determine each
-// instruction.
-enum InstructionCode : uint16_t
+// Single description of the instruction set. The decoder, the disassembler and
+// the compiler are all generated from kInstructionSet, so a new instruction or
+// encoding change is made here only.
+
+// Operations the CPU can perform.
+enum class Operation : uint8_t
 {
-  kHALT       = 0x1000,
-  kNOP        = 0x0000,
-  kLOAD       = 0x2800,
-  kLOADI      = 0x2000,
-  kSTORE      = 0x3800,
-  kSTOREI     = 0x3000,
-  kCALL       = 0x8F00,
-  kJMP        = 0x8700,
-  kMOVI       = 0x8000,
-  kMOV        = 0x1800,
-  kALU        = 0x4000
+  kHALT, kNOP, kLOAD, kLOADI, kSTORE, kSTOREI, kCALL, kJMP, kMOVI, kMOV,
+
+  // Binary ALU
+  kADC, kADD, kSBC, kSUB, kAND, kOR, kXOR,
+
+  // Unary ALU
+  kNOT, kROR, kSHR, kRCR
 };
 
-inline bool is_HALT(uint16_t instruction)
+// Bit field of an instruction word. Fields with zero width are not present in
+// the instruction.
+struct Field
 {
-  return instruction == kHALT;
-}
+  uint8_t shift;
+  uint8_t width;
 
-inline bool is_NOP(uint16_t instruction)
-{
-  return instruction == kNOP;
-}
+  constexpr bool Present() const { return width != 0; }
 
-inline bool is_LOAD(uint16_t instruction)
-{
-  return (instruction & 0xF800) == kLOAD;
-}
+  constexpr uint16_t Mask() const
+  {
+    return ((1u << width) - 1) << shift;
+  }
 
-inline bool is_LOADI(uint16_t instruction)
-{
-  return (instruction & 0xF800) == kLOADI;
-}
+  constexpr uint16_t Extract(uint16_t instruction) const
+  {
+    return (instruction & Mask()) >> shift;
+  }
 
-inline bool is_STORE(uint16_t instruction)
-{
-  return (instruction & 0xF800) == kSTORE;
-}
+  constexpr uint16_t Place(unsigned value) const
+  {
+    return (value << shift) & Mask();
+  }
 
-inline bool is_STOREI(uint16_t instruction)
-{
-  return (instruction & 0xF800) == kSTOREI;
-}
+  // Returns true if value can be placed without losing bits.
+  constexpr bool Fits(int value) const
+  {
+    return !Present() || (value >= 0 && value < 1 << width);
+  }
+};
 
-inline bool is_CALL(uint16_t instruction)
+// Operand values of an instruction. Fields an instruction does not have are
+// ignored when it is encoded. Values are wider than their fields, so that
+// InstructionFormat::Fits() can reject those out of range.
+struct Operands
 {
-  return (instruction & 0x8F00) == kCALL;
-}
+  // Destination register (G for LOAD/STORE).
+  int Gd;
+
+  // Source register (Gs1 for binary ALU, P for LOAD/STORE).
+  int Gs;
+
+  // Second ALU operand or 8-bit immediate.
+  int Op2;
+
+  int cond;
+
+  // ALU result is written to Gd (otherwise only flags are updated).
+  bool r;
 
-inline bool is_JMP(uint16_t instruction)
+  // Op2 holds an immediate value instead of a register code.
+  bool i;
+};
+
+struct InstructionFormat
 {
-  return (instruction & 0x8700) == kJMP;
-}
+  Operation operation;
+  const char* mnemonic;
+
+  // An instruction word belongs to this format if (word & mask) == code.
+  uint16_t mask;
+  uint16_t code;
+
+  Field Gd;
+  Field Gs;
+  Field Op2;
+  Field cond;
+  Field r;
+  Field i;
+
+  constexpr bool Matches(uint16_t instruction) const
+  {
+    return (instruction & mask) == code;
+  }
+
+  // Returns true if every operand of the format fits its field.
+  constexpr bool Fits(const Operands& op) const
+  {
+    return Gd.Fits(op.Gd) && Gs.Fits(op.Gs) && Op2.Fits(op.Op2) &&
+           cond.Fits(op.cond);
+  }
+
+  // Masks every operand to its field, see Fits().
+  constexpr uint16_t Encode(const Operands& op) const
+  {
+    return code | Gd.Place(op.Gd) | Gs.Place(op.Gs) | Op2.Place(op.Op2) |
+           cond.Place(op.cond) | r.Place(op.r) | i.Place(op.i);
+  }
+};
+
+constexpr Field kNone = { 0, 0 };
+constexpr Field kGd = { 8, 3 };
+constexpr Field kGs = { 4, 3 };
+constexpr Field kP = { 0, 3 };
+constexpr Field kImm = { 0, 8 };
+constexpr Field kOp2 = { 0, 3 };
+constexpr Field kCond = { 12, 3 };
+constexpr Field kR = { 3, 1 };
+constexpr Field kI = { 7, 1 };
 
-inline bool is_MOVI(uint16_t instruction)
+// Formats in decoding priority order: a word belongs to the first format it
+// matches, so a MOVI to PC is a JMP and everything that is neither ALU nor
+// anything else with bits 11-12 set is a MOV. Words matching no format are
+// executed as NOP.
+constexpr InstructionFormat kInstructionSet[] = {
+  //  operation          mnemonic  mask    code    Gd     Gs     Op2    cond   r      i
+  { Operation::kHALT,   "HALT",   0xFFFF, 0x1000, kNone, kNone, kNone, kNone, kNone, kNone },
+  { Operation::kNOP,    "NOP",    0xFFFF, 0x0000, kNone, kNone, kNone, kNone, kNone, kNone },
+  { Operation::kLOAD,   "LOAD",   0xF800, 0x2800, kGd,   kP,    kNone, kNone, kNone, kNone },
+  { Operation::kLOADI,  "LOAD",   0xF800, 0x2000, kGd,   kNone, kImm,  kNone, kNone, kNone },
+  { Operation::kSTORE,  "STORE",  0xF800, 0x3800, kGd,   kP,    kNone, kNone, kNone, kNone },
+  { Operation::kSTOREI, "STORE",  0xF800, 0x3000, kGd,   kNone, kImm,  kNone, kNone, kNone },
+  { Operation::kCALL,   "CALL",   0x8F00, 0x8F00, kNone, kNone, kImm,  kCond, kNone, kNone },
+  { Operation::kJMP,    "JMP",    0x8700, 0x8700, kNone, kNone, kImm,  kCond, kNone, kNone },
+  { Operation::kMOVI,   "MOVI",   0x8000, 0x8000, kGd,   kNone, kImm,  kCond, kNone, kNone },
+  { Operation::kADC,    "ADC",    0xF800, 0x4000, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kADD,    "ADD",    0xF800, 0x4800, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kSBC,    "SBC",    0xF800, 0x5000, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kSUB,    "SUB",    0xF800, 0x5800, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kAND,    "AND",    0xF800, 0x6000, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kOR,     "OR",     0xF800, 0x6800, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kXOR,    "XOR",    0xF800, 0x7000, kGd,   kGs,   kOp2,  kNone, kR,    kI    },
+  { Operation::kNOT,    "NOT",    0xF806, 0x7800, kGd,   kGs,   kNone, kNone, kR,    kNone },
+  { Operation::kROR,    "ROR",    0xF806, 0x7802, kGd,   kGs,   kNone, kNone, kR,    kNone },
+  { Operation::kSHR,    "SHR",    0xF806, 0x7804, kGd,   kGs,   kNone, kNone, kR,    kNone },
+  { Operation::kRCR,    "RCR",    0xF806, 0x7806, kGd,   kGs,   kNone, kNone, kR,    kNone },
+  { Operation::kMOV,    "MOV",    0x1800, 0x1800, kGd,   kGs,   kNone, kNone, kNone, kNone }
+};
+
+constexpr int kInstructionSetSize =
+    sizeof(kInstructionSet) / sizeof(kInstructionSet[0]);
+
+// Index used for words that match no format.
+constexpr int kUnknownInstruction = kInstructionSetSize;
+
+// Register and condition names, indexed by their codes.
+constexpr const char* kRegisterNames[] = {
+  "A", "B", "C", "D", "M", "S", "L", "PC"
+};
+
+constexpr const char* kConditionNames[] = {
+  "A", "Z", "NS", "C", "NC", "S", "NZ", ""
+};
+
+// Returns the index of the first format in kInstructionSet that matches the
+// instruction, or kUnknownInstruction.
+constexpr int find_instruction_format(uint16_t instruction, int index = 0)
 {
-  return (instruction & 0x8000) == kMOVI;
+  return index == kInstructionSetSize ? kUnknownInstruction :
+         kInstructionSet[index].Matches(instruction) ? index :
+         find_instruction_format(instruction, index + 1);
 }
 
-inline bool is_MOV(uint16_t instruction)
+// Returns the format of the operation.
+constexpr const InstructionFormat& get_instruction_format(Operation operation,
+                                                          int index = 0)
 {
-  return (instruction & 0x1800) == kMOV;
+  return kInstructionSet[index].operation == operation ?
+         kInstructionSet[index] :
+         get_instruction_format(operation, index + 1);
 }
 
-inline bool is_ALU(uint16_t instruction)
+constexpr uint16_t encode(Operation operation, const Operands& op)
 {
-  return (instruction & 0xC000) == kALU;
+  return get_instruction_format(operation).Encode(op);
 }
+
+static_assert(find_instruction_format(0x1000) == 0, "HALT must be decoded");
+static_assert(encode(Operation::kJMP, { 0, 0, 0x12, 0, false, false }) ==
+              0x8712,
+              "JMP must be encoded");
+static_assert(encode(Operation::kSUB, { 1, 1, 1, 0, true, true }) == 0x5999,
+              "binary ALU must be encoded");
+static_assert(!get_instruction_format(Operation::kADD).Fits(
+                  { 0, 0, 8, 0, true, true }),
+              "ALU immediates must be 3 bits");
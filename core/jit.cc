@@ -0,0 +1,719 @@
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include "core/cpu.h"
+#include "core/jit.h"
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_SUPPORTED 1
+#include <sys/mman.h>
+#else
+#define JIT_SUPPORTED 0
+#endif
+
+typedef DecodedInstruction::Handler Handler;
+
+#if JIT_SUPPORTED
+
+// Host registers
+enum HostRegister : uint8_t
+{
+  kRAX = 0, kRCX = 1, kRDX = 2, kRBX = 3, kRDI = 7,
+
+  // A, B, C, D, M, S and L, in the order of CPU::RegisterCode
+  kR8 = 8
+};
+
+// Host condition codes
+enum HostCondition : uint8_t
+{
+  kB = 0x2, kAE = 0x3, kE = 0x4, kNE = 0x5, kS = 0x8, kNS = 0x9
+};
+
+// Label kinds of the generated code.
+enum class Label
+{
+  // Body of the instruction at an address
+  kBody,
+
+  // Budget check before the straight-line run starting at an address
+  kEntry,
+
+  // Return with PC set to an address
+  kExit,
+
+  // Common return path
+  kReturn
+};
+
+// Emits x86-64 machine code with forward references to labels.
+class Assembler
+{
+  public:
+    Assembler()
+    {
+      for (std::vector<size_t>& positions : labels_)
+      {
+        positions.assign(ROM::kAddressSpaceSize, 0);
+      }
+    }
+
+  public:
+    const std::vector<uint8_t>& GetCode() const { return code_; }
+    size_t GetLabel(Label label, uint8_t addr = 0) const
+    {
+      return labels_[static_cast<int>(label)][addr];
+    }
+
+    void Bind(Label label, uint8_t addr = 0)
+    {
+      labels_[static_cast<int>(label)][addr] = code_.size();
+    }
+
+    // Resolves all rel32 references. Must be called after every label is bound.
+    void Link()
+    {
+      for (const Fixup& fixup : fixups_)
+      {
+        int32_t rel = GetLabel(fixup.label, fixup.addr) - (fixup.position + 4);
+        std::memcpy(&code_[fixup.position], &rel, sizeof(rel));
+      }
+    }
+
+    void Byte(uint8_t byte) { code_.push_back(byte); }
+
+    void Bytes(std::initializer_list<uint8_t> bytes)
+    {
+      code_.insert(code_.end(), bytes);
+    }
+
+    void Imm32(uint32_t value)
+    {
+      for (int i = 0; i < 4; ++i) Byte(value >> (i * 8));
+    }
+
+    void Rel32(Label label, uint8_t addr)
+    {
+      fixups_.push_back({ code_.size(), label, addr });
+      Imm32(0);
+    }
+
+    // op r/m8, r8 (or op r8, r/m8) with both operands in registers.
+    void RegReg8(uint8_t opcode, uint8_t reg, uint8_t rm)
+    {
+      if (reg >= 8 || rm >= 8) Byte(0x40 | (reg >= 8) << 2 | (rm >= 8));
+      Bytes({ opcode, static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7)) });
+    }
+
+    // op reg, [rdi + disp32]
+    void RegMem(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                uint32_t disp, bool wide = false)
+    {
+      if (wide || reg >= 8) Byte(0x40 | wide << 3 | (reg >= 8) << 2);
+      Bytes(opcode);
+      Byte(0x80 | (reg & 7) << 3 | kRDI);
+      Imm32(disp);
+    }
+
+    // op reg, [rdi + rax * scale + disp32]
+    void RegMemIndexed(std::initializer_list<uint8_t> opcode, uint8_t reg,
+                       uint8_t scale_bits, uint32_t disp)
+    {
+      if (reg >= 8) Byte(0x44);
+      Bytes(opcode);
+      Bytes({ static_cast<uint8_t>(0x84 | (reg & 7) << 3),
+              static_cast<uint8_t>(scale_bits << 6 | kRAX << 3 | kRDI) });
+      Imm32(disp);
+    }
+
+    // mov r8, imm8
+    void MovImm8(uint8_t reg, uint8_t imm)
+    {
+      if (reg >= 8) Byte(0x41);
+      Bytes({ static_cast<uint8_t>(0xB0 | (reg & 7)), imm });
+    }
+
+    // op al, imm8 (group 1 with /digit)
+    void AluImm8(uint8_t digit, uint8_t imm)
+    {
+      Bytes({ 0x80, static_cast<uint8_t>(0xC0 | digit << 3), imm });
+    }
+
+    // movzx eax, r8
+    void MovzxEax(uint8_t reg)
+    {
+      if (reg >= 8) Byte(0x41);
+      Bytes({ 0x0F, 0xB6, static_cast<uint8_t>(0xC0 | (reg & 7)) });
+    }
+
+    void MovEdx(uint16_t imm)
+    {
+      Byte(0xBA);
+      Imm32(imm);
+    }
+
+    void Jmp(Label label, uint8_t addr = 0)
+    {
+      Byte(0xE9);
+      Rel32(label, addr);
+    }
+
+    void Jcc(uint8_t cc, Label label, uint8_t addr = 0)
+    {
+      Bytes({ 0x0F, static_cast<uint8_t>(0x80 | cc) });
+      Rel32(label, addr);
+    }
+
+    // Short jcc over the next size bytes.
+    void JccOver(uint8_t cc, uint8_t size)
+    {
+      Bytes({ static_cast<uint8_t>(0x70 | cc), size });
+    }
+
+  private:
+    struct Fixup
+    {
+      size_t position;
+      Label label;
+      uint8_t addr;
+    };
+
+    std::vector<uint8_t> code_;
+    std::vector<Fixup> fixups_;
+    std::vector<size_t> labels_[4];
+};
+
+// Translates one instruction at a time into an Assembler.
+class Translator
+{
+  public:
+    Translator(Assembler& as, const BlockCache::Program& program)
+        : as_(as), program_(program)
+    {
+    }
+
+  public:
+    void Prologue();
+    void Body(uint8_t pc);
+    void Entry(uint8_t pc, uint64_t length);
+
+    // Entry that returns at once, so the caller executes what is at pc.
+    void ReturnEntry(uint8_t pc);
+    void Exit(uint8_t pc);
+    void Return();
+
+  private:
+    static uint8_t Host(uint8_t code) { return kR8 + code; }
+    static uint8_t Negate(uint8_t cc) { return cc ^ 1; }
+    static uint8_t Condition(uint8_t cond);
+
+    // Loads the value of register code into al. PC reads as the address of the
+    // next instruction.
+    void LoadOperand(uint8_t pc, uint8_t code);
+
+    // Writes al to register code. A write to PC jumps to the new address.
+    void StoreResult(uint8_t code);
+
+    // Jumps to the run starting at the address in eax.
+    void Dispatch();
+
+    void ALU(uint8_t pc, const DecodedInstruction& op);
+
+  private:
+    Assembler& as_;
+    const BlockCache::Program& program_;
+};
+
+// Returns true if addr is an input switch word.
+static bool is_input(int addr)
+{
+  return addr >= ROM::kProgramDataSize &&
+         addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize;
+}
+
+// Returns true if a counting loop that doesn't cover input switch words
+// starts at pc. Those the caller skips.
+static bool is_counting_loop(const BlockCache::Program& program, uint8_t pc)
+{
+  std::unique_ptr<CountingLoop> loop = recognize_counting_loop(program, pc);
+
+  if (!loop) return false;
+
+  for (int offset = 0; offset < loop->size; ++offset)
+  {
+    if (is_input(static_cast<uint8_t>(pc + offset))) return false;
+  }
+
+  return true;
+}
+
+// Offset from rdi of a State field.
+static uint32_t state_field(size_t offset)
+{
+  return offsetof(JIT::Context, state) + offset;
+}
+
+static const uint32_t kRegisters = state_field(offsetof(JIT::State, registers));
+static const uint32_t kMemory = offsetof(JIT::Context, memory);
+
+void Translator::Prologue()
+{
+  // push rbx, r12, r13, r14
+  as_.Bytes({ 0x53, 0x41, 0x54, 0x41, 0x55, 0x41, 0x56 });
+
+  for (uint8_t code = CPU::kA; code < CPU::kPC; ++code)
+  {
+    // mov rN, [rdi + registers[code]]
+    as_.RegMem({ 0x8A }, Host(code), kRegisters + code);
+  }
+
+  // mov rcx, [rdi + budget]
+  as_.RegMem({ 0x8B }, kRCX, state_field(offsetof(JIT::State, budget)), true);
+
+  // movzx edx, word [rdi + instruction]
+  as_.RegMem({ 0x0F, 0xB7 }, kRDX,
+             state_field(offsetof(JIT::State, instruction)));
+
+  // mov ah, [rdi + host_flags]; sahf
+  as_.Bytes({ 0x8A, 0xA7 });
+  as_.Imm32(offsetof(JIT::Context, host_flags));
+  as_.Byte(0x9E);
+
+  // movzx eax, byte [rdi + PC]
+  as_.RegMem({ 0x0F, 0xB6 }, kRAX, kRegisters + CPU::kPC);
+  Dispatch();
+}
+
+void Translator::Entry(uint8_t pc, uint64_t length)
+{
+  as_.Bind(Label::kEntry, pc);
+
+  // Keep the flags in ah while checking the budget.
+  as_.Byte(0x9F);
+
+  // cmp rcx, length; jb exit
+  as_.Bytes({ 0x48, 0x81, 0xF9 });
+  as_.Imm32(length);
+  as_.Jcc(kB, Label::kExit, pc);
+
+  // sub rcx, length; sahf
+  as_.Bytes({ 0x48, 0x81, 0xE9 });
+  as_.Imm32(length);
+  as_.Byte(0x9E);
+
+  as_.Jmp(Label::kBody, pc);
+}
+
+void Translator::ReturnEntry(uint8_t pc)
+{
+  as_.Bind(Label::kEntry, pc);
+
+  // lahf, for the sahf of the exit.
+  as_.Byte(0x9F);
+  as_.Jmp(Label::kExit, pc);
+}
+
+void Translator::Exit(uint8_t pc)
+{
+  as_.Bind(Label::kExit, pc);
+
+  // Restore the flags saved by the entry, then mov byte [rdi + PC], pc.
+  as_.Byte(0x9E);
+  as_.Bytes({ 0xC6, 0x87 });
+  as_.Imm32(kRegisters + CPU::kPC);
+  as_.Byte(pc);
+
+  as_.Jmp(Label::kReturn);
+}
+
+void Translator::Return()
+{
+  as_.Bind(Label::kReturn);
+
+  // setcc byte [rdi + flag]
+  const std::pair<uint8_t, uint32_t> flags[] = {
+    { kS, state_field(offsetof(JIT::State, sign)) },
+    { kE, state_field(offsetof(JIT::State, zero)) },
+    { kB, state_field(offsetof(JIT::State, carry)) }
+  };
+  for (const std::pair<uint8_t, uint32_t>& flag : flags)
+  {
+    as_.RegMem({ 0x0F, static_cast<uint8_t>(0x90 | flag.first) }, 0,
+               flag.second);
+  }
+
+  for (uint8_t code = CPU::kA; code < CPU::kPC; ++code)
+  {
+    // mov [rdi + registers[code]], rN
+    as_.RegMem({ 0x88 }, Host(code), kRegisters + code);
+  }
+
+  // mov [rdi + budget], rcx
+  as_.RegMem({ 0x89 }, kRCX, state_field(offsetof(JIT::State, budget)), true);
+
+  // mov [rdi + instruction], dx
+  as_.Byte(0x66);
+  as_.RegMem({ 0x89 }, kRDX, state_field(offsetof(JIT::State, instruction)));
+
+  // pop r14, r13, r12, rbx; ret
+  as_.Bytes({ 0x41, 0x5E, 0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3 });
+}
+
+void Translator::Body(uint8_t pc)
+{
+  const DecodedInstruction& op = program_[pc];
+  uint8_t next = pc + 1;
+
+  as_.Bind(Label::kBody, pc);
+
+  // The last instruction of a run records itself as the instruction register,
+  // so a return before the next run reports it.
+  bool ends_run = op.ChangesControlFlow() || next == 0 || is_input(next);
+  if (ends_run) as_.MovEdx(op.instruction);
+
+  switch (op.handler)
+  {
+    case Handler::kHALT:
+    {
+      // mov byte [rdi + PC], next; mov byte [rdi + halted], 1
+      as_.Bytes({ 0xC6, 0x87 });
+      as_.Imm32(kRegisters + CPU::kPC);
+      as_.Byte(next);
+      as_.Bytes({ 0xC6, 0x87 });
+      as_.Imm32(state_field(offsetof(JIT::State, halted)));
+      as_.Byte(1);
+
+      as_.Jmp(Label::kReturn);
+      return;
+    }
+    case Handler::kLOAD: case Handler::kLOADI:
+    {
+      if (op.handler == Handler::kLOADI || op.Gs == CPU::kPC)
+      {
+        // mov al, [rdi + memory + addr]
+        uint8_t addr = op.handler == Handler::kLOADI ? op.Op2 : next;
+        as_.RegMem({ 0x8A }, kRAX, kMemory + addr);
+        StoreResult(op.Gd);
+      }
+      else if (op.Gs > CPU::kM)
+      {
+        // movzx eax, P; mov al, [rdi + rax + memory]
+        as_.MovzxEax(Host(op.Gs));
+        as_.RegMemIndexed({ 0x8A }, kRAX, 0, kMemory);
+        StoreResult(op.Gd);
+      }
+      break;
+    }
+    case Handler::kCALL: case Handler::kJMP:
+    {
+      uint8_t cc = Condition(op.cond);
+
+      if (op.handler == Handler::kCALL && op.cond != 0b111)
+      {
+        // Skip mov r14b, next (3 bytes) and jmp entry (5 bytes).
+        if (op.cond != 0b000) as_.JccOver(Negate(cc), 8);
+        as_.MovImm8(Host(CPU::kL), next);
+        as_.Jmp(Label::kEntry, op.Op2);
+      }
+      else if (op.cond == 0b000)
+      {
+        as_.Jmp(Label::kEntry, op.Op2);
+      }
+      else if (op.cond != 0b111)
+      {
+        as_.Jcc(cc, Label::kEntry, op.Op2);
+      }
+      break;
+    }
+    case Handler::kMOVI:
+    {
+      if (op.cond == 0b111) break;
+      // Skip mov rN, imm8 (3 bytes).
+      if (op.cond != 0b000) as_.JccOver(Negate(Condition(op.cond)), 3);
+
+      as_.MovImm8(Host(op.Gd), op.Op2);
+      break;
+    }
+    case Handler::kMOV:
+    {
+      LoadOperand(pc, op.Gs);
+      StoreResult(op.Gd);
+      break;
+    }
+    case Handler::kNOP: case Handler::kSTORE: case Handler::kSTOREI:
+    {
+      // Bus::Write ignores stores.
+      break;
+    }
+    default:
+    {
+      ALU(pc, op);
+      break;
+    }
+  }
+
+  if (ends_run) as_.Jmp(Label::kEntry, next);
+}
+
+void Translator::ALU(uint8_t pc, const DecodedInstruction& op)
+{
+  LoadOperand(pc, op.Gs);
+
+  switch (op.handler)
+  {
+    case Handler::kNOT:
+    {
+      // xor al, 0xFF
+      as_.AluImm8(6, 0xFF);
+      break;
+    }
+    case Handler::kROR:
+    {
+      // ror al, 1; test al, al
+      as_.Bytes({ 0xD0, 0xC8, 0x84, 0xC0 });
+      break;
+    }
+    case Handler::kSHR:
+    {
+      // shr al, 1
+      as_.Bytes({ 0xD0, 0xE8 });
+      break;
+    }
+    case Handler::kRCR:
+    {
+      // rcr al, 1; setc bl; test al, al; lahf; or ah, bl; sahf
+      as_.Bytes({ 0xD0, 0xD8, 0x0F, 0x92, 0xC3, 0x84, 0xC0,
+                  0x9F, 0x08, 0xDC, 0x9E });
+      break;
+    }
+    default:
+    {
+      // Group 1 /digit and "op r/m8, r8" opcodes of ADC, ADD, SBC, SUB, AND,
+      // OR and XOR
+      const uint8_t kDigits[] = { 2, 0, 3, 5, 4, 1, 6 };
+      const uint8_t kOpcodes[] = { 0x10, 0x00, 0x18, 0x28, 0x20, 0x08, 0x30 };
+      int index = static_cast<int>(op.handler) -
+                  static_cast<int>(Handler::kADC);
+
+      if (op.HasImmediate())
+      {
+        as_.AluImm8(kDigits[index], op.Op2);
+      }
+      else if (op.Op2 == CPU::kPC)
+      {
+        as_.AluImm8(kDigits[index], pc + 1);
+      }
+      else
+      {
+        as_.RegReg8(kOpcodes[index], Host(op.Op2), kRAX);
+      }
+      break;
+    }
+  }
+
+  if (op.WritesResult()) StoreResult(op.Gd);
+}
+
+void Translator::LoadOperand(uint8_t pc, uint8_t code)
+{
+  if (code == CPU::kPC)
+  {
+    as_.MovImm8(kRAX, pc + 1);
+  }
+  else
+  {
+    // mov al, rN
+    as_.RegReg8(0x88, Host(code), kRAX);
+  }
+}
+
+void Translator::StoreResult(uint8_t code)
+{
+  if (code == CPU::kPC)
+  {
+    // movzx eax, al
+    as_.Bytes({ 0x0F, 0xB6, 0xC0 });
+    Dispatch();
+  }
+  else
+  {
+    // mov rN, al
+    as_.RegReg8(0x88, kRAX, Host(code));
+  }
+}
+
+void Translator::Dispatch()
+{
+  // jmp [rdi + rax * 8 + entries]
+  as_.Bytes({ 0xFF, 0xA4, 0xC7 });
+  as_.Imm32(offsetof(JIT::Context, entries));
+}
+
+uint8_t Translator::Condition(uint8_t cond)
+{
+  switch (cond)
+  {
+    case 0b001: return kE;
+    case 0b010: return kNS;
+    case 0b011: return kB;
+    case 0b100: return kAE;
+    case 0b101: return kS;
+    case 0b110: default: return kNE;
+  }
+}
+
+#endif
+
+JIT::~JIT()
+{
+  Release();
+}
+
+JIT::JIT(JIT&& other)
+{
+  *this = std::move(other);
+}
+
+JIT& JIT::operator=(JIT&& other)
+{
+  if (this != &other)
+  {
+    Release();
+
+    context_ = other.context_;
+    code_ = other.code_;
+    code_size_ = other.code_size_;
+    valid_ = other.valid_;
+    refused_ = other.refused_;
+
+    other.code_ = nullptr;
+    other.code_size_ = 0;
+    other.valid_ = false;
+  }
+
+  return *this;
+}
+
+bool JIT::Supported()
+{
+  return JIT_SUPPORTED;
+}
+
+bool JIT::Execute(State& state, const BlockCache::Program& program)
+{
+#if JIT_SUPPORTED
+  if (!valid_ && (refused_ || !Translate(program))) return false;
+
+  context_.state = state;
+  context_.state.halted = false;
+  context_.host_flags = state.carry | state.zero << 6 | state.sign << 7;
+
+  reinterpret_cast<void (*)(Context*)>(code_)(&context_);
+
+  state = context_.state;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void JIT::Input(const BlockCache::Program& program)
+{
+  for (int addr = ROM::kProgramDataSize;
+       addr < ROM::kProgramDataSize + ROM::kInputSwitchesSize; ++addr)
+  {
+    context_.memory[addr] = program[addr].instruction & 0x00FF;
+  }
+}
+
+bool JIT::Translate(const BlockCache::Program& program)
+{
+#if JIT_SUPPORTED
+  Release();
+
+  Assembler as;
+  Translator translator(as, program);
+
+  translator.Prologue();
+
+  // Input switch words change between runs without a new translation, so
+  // they are left to the caller.
+  for (int pc = 0; pc < ROM::kAddressSpaceSize; ++pc)
+  {
+    if (!is_input(pc)) translator.Body(pc);
+  }
+
+  // Length of the straight-line run starting at every address
+  uint64_t length[ROM::kAddressSpaceSize + 1] = {};
+  for (int pc = ROM::kAddressSpaceSize - 1; pc >= 0; --pc)
+  {
+    bool ends_run = program[pc].ChangesControlFlow() ||
+                    pc == ROM::kAddressSpaceSize - 1 || is_input(pc + 1);
+    length[pc] = ends_run ? 1 : length[pc + 1] + 1;
+  }
+
+  for (int pc = 0; pc < ROM::kAddressSpaceSize; ++pc)
+  {
+    if (is_input(pc) || is_counting_loop(program, pc))
+    {
+      translator.ReturnEntry(pc);
+    }
+    else
+    {
+      translator.Entry(pc, length[pc]);
+    }
+
+    translator.Exit(pc);
+  }
+
+  translator.Return();
+  as.Link();
+
+  const std::vector<uint8_t>& code = as.GetCode();
+  void* buffer = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (buffer == MAP_FAILED)
+  {
+    refused_ = true;
+    return false;
+  }
+
+  std::memcpy(buffer, code.data(), code.size());
+
+  // Hardened kernels may refuse to make written memory executable.
+  if (mprotect(buffer, code.size(), PROT_READ | PROT_EXEC) == -1)
+  {
+    munmap(buffer, code.size());
+    refused_ = true;
+    return false;
+  }
+
+  code_ = static_cast<uint8_t*>(buffer);
+  code_size_ = code.size();
+
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    context_.memory[addr] = program[addr].instruction & 0x00FF;
+    context_.entries[addr] = code_ + as.GetLabel(Label::kEntry, addr);
+  }
+
+  valid_ = true;
+#endif
+  return valid_;
+}
+
+void JIT::Release()
+{
+#if JIT_SUPPORTED
+  if (code_)
+  {
+    munmap(code_, code_size_);
+  }
+#endif
+
+  code_ = nullptr;
+  code_size_ = 0;
+  valid_ = false;
+}
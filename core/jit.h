@@ -0,0 +1,97 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#include "core/blockcache.h"
+
+// Translates the whole address space into x86-64 code. General purpose and
+// memory registers live in r8-r14, PC is implicit in the position of the
+// generated code, and the S, Z and CY flags are kept in the host SF, ZF and CF
+// between instructions.
+//
+// The budget is checked once per straight-line run of instructions. If the
+// remaining budget does not cover the run, the translated code returns before
+// it, so the caller can finish the budget exactly with the interpreter. It also
+// returns before every counting loop (see core/loops.h) for the caller to
+// skip, and before the input switch words, which the caller executes, so the
+// translation stays valid when the input changes.
+class JIT
+{
+  public:
+    // Machine state exchanged with the translated code.
+    struct State
+    {
+      // Indexed by CPU::RegisterCode
+      uint8_t registers[8];
+
+      bool sign;
+      bool zero;
+      bool carry;
+      bool halted;
+
+      // Last executed instruction
+      uint16_t instruction;
+
+      // Number of instructions that may still be executed
+      uint64_t budget;
+    };
+
+  public:
+    JIT() = default;
+    ~JIT();
+
+    // Movable only
+    JIT(const JIT&) = delete;
+    JIT& operator=(const JIT&) = delete;
+    JIT(JIT&& other);
+    JIT& operator=(JIT&& other);
+
+  public:
+    // Returns true if translated code can be executed on this host.
+    static bool Supported();
+
+    // Runs translated code on state until HALT or until the budget does not
+    // cover the next straight-line run. Translates program on first use.
+    // Returns false, leaving state alone, if the host refuses executable
+    // memory, in which case the caller interprets instead.
+    bool Execute(State& state, const BlockCache::Program& program);
+
+    // Drops translated code. Called whenever the program changes.
+    void Invalidate() { valid_ = false; }
+
+    // Updates the input switch words read by LOAD. Called when the input
+    // changes.
+    void Input(const BlockCache::Program& program);
+
+  public:
+    // Everything the translated code addresses through rdi.
+    struct Context
+    {
+      State state;
+
+      // Flags in the format of the lahf/sahf instructions
+      uint8_t host_flags;
+
+      // Low bytes of every readable word, for LOAD
+      uint8_t memory[ROM::kAddressSpaceSize];
+
+      // Entry point of the straight-line run starting at every address
+      const uint8_t* entries[ROM::kAddressSpaceSize];
+    };
+
+  private:
+    // Returns false if the translation can't be made executable.
+    bool Translate(const BlockCache::Program& program);
+    void Release();
+
+  private:
+    Context context_;
+
+    uint8_t* code_ = nullptr;
+    size_t code_size_ = 0;
+
+    bool valid_ = false;
+
+    // Set once the host refuses executable memory, which it keeps doing
+    bool refused_ = false;
+};
@@ -0,0 +1,468 @@
+#include <cstring>
+
+#include "core/lanecpu.h"
+
+typedef DecodedInstruction::Handler Handler;
+
+#if defined(__GNUC__)
+// Host vector with one byte per lane. The compiler maps operations on it to
+// the widest vector instructions of the target, e.g. one AVX2 instruction for
+// 32 lanes, or two SSE2 ones.
+typedef uint8_t Vector __attribute__((vector_size(LaneCPU::kLanes)));
+
+// Every helper taking or returning vectors is inlined into the kernel, so
+// vectors never cross a call between code built for different targets.
+#define LANES_INLINE inline __attribute__((always_inline))
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+static LANES_INLINE Vector splat(uint8_t value)
+{
+  return Vector{} + value;
+}
+
+static LANES_INLINE Vector equal(Vector a, Vector b)
+{
+  return reinterpret_cast<Vector>(a == b);
+}
+
+static LANES_INLINE Vector less(Vector a, Vector b)
+{
+  return reinterpret_cast<Vector>(a < b);
+}
+#else
+struct Vector
+{
+  uint8_t lanes[LaneCPU::kLanes];
+
+  uint8_t& operator[](int lane) { return lanes[lane]; }
+  uint8_t operator[](int lane) const { return lanes[lane]; }
+};
+
+#define LANES_INLINE inline
+
+#define LANES_OPERATOR(op)                                          \
+  static inline Vector operator op(Vector a, Vector b)              \
+  {                                                                 \
+    for (int lane = 0; lane < LaneCPU::kLanes; ++lane)              \
+    {                                                               \
+      a[lane] = a[lane] op b[lane];                                 \
+    }                                                               \
+    return a;                                                       \
+  }                                                                 \
+  static inline Vector& operator op##=(Vector& a, Vector b)         \
+  {                                                                 \
+    return a = a op b;                                              \
+  }
+
+LANES_OPERATOR(+)
+LANES_OPERATOR(-)
+LANES_OPERATOR(&)
+LANES_OPERATOR(|)
+LANES_OPERATOR(^)
+
+#undef LANES_OPERATOR
+
+static inline Vector operator~(Vector a)
+{
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane) a[lane] = ~a[lane];
+  return a;
+}
+
+static inline Vector operator>>(Vector a, int bits)
+{
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane) a[lane] >>= bits;
+  return a;
+}
+
+static inline Vector operator<<(Vector a, int bits)
+{
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane) a[lane] <<= bits;
+  return a;
+}
+
+static inline Vector splat(uint8_t value)
+{
+  Vector v;
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane) v[lane] = value;
+  return v;
+}
+
+static inline Vector equal(Vector a, Vector b)
+{
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane)
+  {
+    a[lane] = a[lane] == b[lane] ? 0xFF : 0x00;
+  }
+  return a;
+}
+
+static inline Vector less(Vector a, Vector b)
+{
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane)
+  {
+    a[lane] = a[lane] < b[lane] ? 0xFF : 0x00;
+  }
+  return a;
+}
+#endif
+
+// The kernel is compiled both for AVX2 and for the baseline instruction set,
+// and the dynamic loader picks the variant the host supports.
+#if defined(__GNUC__) && defined(__x86_64__) && defined(__linux__) && \
+    !defined(__clang__)
+#define LANES_MULTIVERSION __attribute__((target_clones("avx2", "default")))
+#else
+#define LANES_MULTIVERSION
+#endif
+
+// Vector copy of LaneCPU::State, kept in host registers while lanes run.
+struct Lanes
+{
+  Vector registers[8];
+
+  Vector sign;
+  Vector zero;
+  Vector carry;
+  Vector halted;
+
+  Vector instruction_low;
+  Vector instruction_high;
+
+  Vector input[2];
+};
+
+static LANES_INLINE Vector select(Vector mask, Vector a, Vector b)
+{
+  return (a & mask) | (b & ~mask);
+}
+
+static LANES_INLINE bool any(Vector mask)
+{
+  uint64_t words[LaneCPU::kLanes / 8];
+  memcpy(words, &mask, sizeof(words));
+
+  uint64_t result = 0;
+  for (uint64_t word : words) result |= word;
+
+  return result != 0;
+}
+
+static LANES_INLINE int first_lane(Vector mask)
+{
+  int lane = 0;
+  while (!mask[lane]) ++lane;
+
+  return lane;
+}
+
+static LANES_INLINE bool is_input(uint8_t addr)
+{
+  return addr == 0x80 || addr == 0x81;
+}
+
+static LANES_INLINE Vector check_condition(const Lanes& s, uint8_t cond)
+{
+  switch (cond)
+  {
+    case 0b000: return splat(0xFF);
+    case 0b001: return s.zero;
+    case 0b010: return ~s.sign;
+    case 0b011: return s.carry;
+    case 0b100: return ~s.carry;
+    case 0b101: return s.sign;
+    case 0b110: return ~s.zero;
+    default: return splat(0x00);
+  }
+}
+
+// Reads the low byte of the word at every address in lanes of mask. Memory
+// is the same for every lane except the input switches, so LOAD from a
+// register gathers one lane at a time.
+static LANES_INLINE Vector gather(const Lanes& s, Vector addresses,
+                                  Vector mask, const uint8_t* memory)
+{
+  Vector values = {};
+
+  for (int lane = 0; lane < LaneCPU::kLanes; ++lane)
+  {
+    if (!mask[lane]) continue;
+
+    uint8_t addr = addresses[lane];
+    values[lane] = is_input(addr) ? s.input[addr - 0x80][lane] : memory[addr];
+  }
+
+  return values;
+}
+
+static LANES_INLINE Vector read(const Lanes& s, uint8_t addr,
+                                const uint8_t* memory)
+{
+  return is_input(addr) ? s.input[addr - 0x80] : splat(memory[addr]);
+}
+
+static LANES_INLINE void execute_alu(Lanes& s, const DecodedInstruction& op,
+                                     Vector mask)
+{
+  Vector x = s.registers[op.Gs];
+  Vector y = op.HasImmediate() ? splat(op.Op2) : s.registers[op.Op2];
+  Vector result;
+  Vector carry = splat(0x00);
+
+  switch (op.handler)
+  {
+    case Handler::kADC:
+    {
+      Vector sum = x + y;
+      result = sum + (s.carry & splat(0x01));
+      carry = less(sum, x) | less(result, sum);
+      break;
+    }
+    case Handler::kADD:
+      result = x + y;
+      carry = less(result, x);
+      break;
+    case Handler::kSBC:
+      result = x - y - (s.carry & splat(0x01));
+      carry = less(x, y) | (equal(x, y) & s.carry);
+      break;
+    case Handler::kSUB:
+      result = x - y;
+      carry = less(x, y);
+      break;
+    case Handler::kAND: result = x & y; break;
+    case Handler::kOR: result = x | y; break;
+    case Handler::kXOR: result = x ^ y; break;
+    case Handler::kNOT: result = ~x; break;
+    case Handler::kROR: result = (x >> 1) | (x << 7); break;
+    case Handler::kSHR:
+      result = x >> 1;
+      carry = splat(0x00) - (x & splat(0x01));
+      break;
+    case Handler::kRCR: default:
+      result = (x >> 1) | (s.carry & splat(0x80));
+      carry = splat(0x00) - (x & splat(0x01));
+      break;
+  }
+
+  s.carry = select(mask, carry, s.carry);
+  s.zero = select(mask, equal(result, splat(0x00)), s.zero);
+  s.sign = select(mask, splat(0x00) - (result >> 7), s.sign);
+
+  if (op.WritesResult())
+  {
+    s.registers[op.Gd] = select(mask, result, s.registers[op.Gd]);
+  }
+}
+
+// Executes op in the lanes of mask.
+static LANES_INLINE void execute(Lanes& s, const DecodedInstruction& op,
+                                 Vector mask, const uint8_t* memory)
+{
+  Vector* r = s.registers;
+
+  s.instruction_low = select(mask, splat(op.instruction & 0xFF),
+                             s.instruction_low);
+  s.instruction_high = select(mask, splat(op.instruction >> 8),
+                              s.instruction_high);
+
+  // As in CPU, PC is incremented before the operands are read. Taken CALL and
+  // JMP overwrite it.
+  r[CPU::kPC] = select(mask, r[CPU::kPC] + splat(0x01), r[CPU::kPC]);
+
+  switch (op.handler)
+  {
+    case Handler::kHALT:
+      s.halted |= mask;
+      break;
+    case Handler::kNOP: case Handler::kSTORE: case Handler::kSTOREI:
+      break;
+    case Handler::kLOAD:
+      if (op.Gs > CPU::kM)
+      {
+        r[op.Gd] = select(mask, gather(s, r[op.Gs], mask, memory), r[op.Gd]);
+      }
+      break;
+    case Handler::kLOADI:
+      r[op.Gd] = select(mask, read(s, op.Op2, memory), r[op.Gd]);
+      break;
+    case Handler::kCALL:
+    {
+      Vector taken = mask & check_condition(s, op.cond);
+      r[CPU::kL] = select(taken, r[CPU::kPC], r[CPU::kL]);
+      r[CPU::kPC] = select(taken, splat(op.Op2), r[CPU::kPC]);
+      break;
+    }
+    case Handler::kJMP:
+    {
+      Vector taken = mask & check_condition(s, op.cond);
+      r[CPU::kPC] = select(taken, splat(op.Op2), r[CPU::kPC]);
+      break;
+    }
+    case Handler::kMOVI:
+    {
+      Vector taken = mask & check_condition(s, op.cond);
+      r[op.Gd] = select(taken, splat(op.Op2), r[op.Gd]);
+      break;
+    }
+    case Handler::kMOV:
+      r[op.Gd] = select(mask, r[op.Gs], r[op.Gd]);
+      break;
+    default:
+      execute_alu(s, op, mask);
+      break;
+  }
+}
+
+// Runs up to budget lockstep steps. Every step executes one instruction on
+// each lane that has not halted, grouping the lanes by PC.
+LANES_MULTIVERSION
+static uint64_t run_lanes(LaneCPU::State& state,
+                          const BlockCache::Program& program,
+                          const uint8_t* memory, uint64_t budget,
+                          uint64_t steps, uint64_t* retired)
+{
+  Lanes s;
+
+  memcpy(s.registers, state.registers, sizeof(state.registers));
+  memcpy(&s.sign, state.sign, sizeof(state.sign));
+  memcpy(&s.zero, state.zero, sizeof(state.zero));
+  memcpy(&s.carry, state.carry, sizeof(state.carry));
+  memcpy(&s.halted, state.halted, sizeof(state.halted));
+  memcpy(&s.instruction_low, state.instruction_low,
+         sizeof(state.instruction_low));
+  memcpy(&s.instruction_high, state.instruction_high,
+         sizeof(state.instruction_high));
+  memcpy(s.input, state.input, sizeof(state.input));
+
+  uint64_t step = 0;
+  for (; step < budget; ++step)
+  {
+    Vector pending = ~s.halted;
+
+    if (!any(pending)) break;
+
+    do
+    {
+      int lane = first_lane(pending);
+      uint8_t pc = s.registers[CPU::kPC][lane];
+      Vector mask = pending & equal(s.registers[CPU::kPC], splat(pc));
+      DecodedInstruction op;
+
+      if (is_input(pc))
+      {
+        // Lanes at the same input switch word may still hold different
+        // instructions there.
+        const Vector& words = s.input[pc - 0x80];
+        mask &= equal(words, splat(words[lane]));
+        op = decode(words[lane]);
+      }
+      else
+      {
+        op = program[pc];
+      }
+
+      execute(s, op, mask, memory);
+
+      if (op.handler == Handler::kHALT)
+      {
+        for (int halted = 0; halted < LaneCPU::kLanes; ++halted)
+        {
+          if (mask[halted]) retired[halted] = steps + step + 1;
+        }
+      }
+
+      pending &= ~mask;
+    } while (any(pending));
+  }
+
+  memcpy(state.registers, s.registers, sizeof(state.registers));
+  memcpy(state.sign, &s.sign, sizeof(state.sign));
+  memcpy(state.zero, &s.zero, sizeof(state.zero));
+  memcpy(state.carry, &s.carry, sizeof(state.carry));
+  memcpy(state.halted, &s.halted, sizeof(state.halted));
+  memcpy(state.instruction_low, &s.instruction_low,
+         sizeof(state.instruction_low));
+  memcpy(state.instruction_high, &s.instruction_high,
+         sizeof(state.instruction_high));
+
+  return step;
+}
+
+LaneCPU::LaneCPU(const ROM& rom)
+{
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    uint16_t word = addr < ROM::kProgramDataSize ?
+                    rom.ReadProgramData(addr) : 0x0000;
+
+    program_[addr] = decode(word);
+    memory_[addr] = word & 0x00FF;
+  }
+
+  for (int lane = 0; lane < kLanes; ++lane)
+  {
+    Input(lane, rom.ReadInputSwitches(0x80), rom.ReadInputSwitches(0x81));
+  }
+
+  Reset();
+}
+
+void LaneCPU::Input(int lane, uint8_t first, uint8_t second)
+{
+  state_.input[0][lane] = first;
+  state_.input[1][lane] = second;
+}
+
+uint64_t LaneCPU::Run(uint64_t budget)
+{
+  uint64_t steps = run_lanes(state_, program_, memory_, budget, steps_,
+                             retired_);
+  steps_ += steps;
+
+  return steps;
+}
+
+void LaneCPU::Reset()
+{
+  memset(state_.registers, 0, sizeof(state_.registers));
+  memset(state_.sign, 0, sizeof(state_.sign));
+  memset(state_.zero, 0, sizeof(state_.zero));
+  memset(state_.carry, 0, sizeof(state_.carry));
+  memset(state_.halted, 0, sizeof(state_.halted));
+  memset(state_.instruction_low, 0, sizeof(state_.instruction_low));
+  memset(state_.instruction_high, 0, sizeof(state_.instruction_high));
+
+  steps_ = 0;
+  memset(retired_, 0, sizeof(retired_));
+}
+
+bool LaneCPU::AllHalted() const
+{
+  for (int lane = 0; lane < kLanes; ++lane)
+  {
+    if (!state_.halted[lane]) return false;
+  }
+
+  return true;
+}
+
+bool LaneCPU::GetFlag(int lane, CPU::Flag flag) const
+{
+  switch (flag)
+  {
+    case CPU::Flag::kCY: return state_.carry[lane];
+    case CPU::Flag::kZ: return state_.zero[lane];
+    case CPU::Flag::kS: return state_.sign[lane];
+    default: return false;
+  }
+}
+
+uint16_t LaneCPU::GetInstructionRegister(int lane) const
+{
+  return state_.instruction_high[lane] << 8 | state_.instruction_low[lane];
+}
+
+uint64_t LaneCPU::GetExecuted(int lane) const
+{
+  return state_.halted[lane] ? retired_[lane] : steps_;
+}
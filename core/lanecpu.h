@@ -0,0 +1,82 @@
+#pragma once
+#include <cstdint>
+
+#include "core/blockcache.h"
+#include "core/cpu.h"
+#include "core/rom.h"
+
+// Runs kLanes machines with the same program in lockstep, for example with
+// different input switch values. The state is kept in structure-of-arrays
+// form, one byte lane per machine, so a single host vector holds one register
+// of every machine.
+//
+// Lanes at the same PC execute each instruction together. Lanes that diverge
+// on a branch are executed in turn under a mask, and every lane retires on its
+// own HALT.
+class LaneCPU
+{
+  public:
+    static const int kLanes = 32;
+
+    // Machine state of every lane. Flags and halted hold 0xFF where set.
+    struct State
+    {
+      // Indexed by CPU::RegisterCode
+      uint8_t registers[8][kLanes];
+
+      uint8_t sign[kLanes];
+      uint8_t zero[kLanes];
+      uint8_t carry[kLanes];
+      uint8_t halted[kLanes];
+
+      // Last executed instruction, split into low and high bytes
+      uint8_t instruction_low[kLanes];
+      uint8_t instruction_high[kLanes];
+
+      // Values of the input switches at 0x80 and 0x81
+      uint8_t input[2][kLanes];
+    };
+
+  public:
+    LaneCPU(const ROM& rom = ROM());
+
+  public:
+    // Sets the input switches of lane.
+    void Input(int lane, uint8_t first, uint8_t second);
+
+    // Executes up to budget instructions on every lane that has not halted.
+    // Returns the number of lockstep steps, i.e. the number of instructions
+    // executed by the lane that ran longest.
+    uint64_t Run(uint64_t budget);
+
+    // Resets the state of every lane except the input switches.
+    void Reset();
+
+    bool Halted(int lane) const { return state_.halted[lane]; }
+    bool AllHalted() const;
+
+    uint8_t GetRegister(int lane, uint8_t code) const
+    {
+      return state_.registers[code & 0x07][lane];
+    }
+
+    bool GetFlag(int lane, CPU::Flag flag) const;
+    uint16_t GetInstructionRegister(int lane) const;
+
+    // Returns the number of instructions lane has executed since Reset().
+    uint64_t GetExecuted(int lane) const;
+
+  private:
+    State state_;
+
+    // Decoded copy of every word that is the same for all lanes. The input
+    // switch words are decoded per lane.
+    BlockCache::Program program_;
+
+    // Low bytes of every word, for LOAD
+    uint8_t memory_[ROM::kAddressSpaceSize];
+
+    // Steps executed since Reset(), and the step on which each lane halted.
+    uint64_t steps_ = 0;
+    uint64_t retired_[kLanes];
+};
@@ -0,0 +1,44 @@
+#include <cstring>
+
+#include "core/loopdetector.h"
+
+bool LoopDetector::Check(const CPUBase::State& state)
+{
+  Key key;
+  memcpy(key.registers, state.registers, sizeof(key.registers));
+  key.flags = CPUBase::PackFlags(state);
+
+  if (!has_saved_)
+  {
+    saved_ = key;
+    has_saved_ = true;
+    return false;
+  }
+
+  if (key == saved_)
+  {
+    return true;
+  }
+
+  if (++length_ == power_)
+  {
+    saved_ = key;
+    power_ *= 2;
+    length_ = 0;
+  }
+
+  return false;
+}
+
+void LoopDetector::Reset()
+{
+  has_saved_ = false;
+  power_ = 1;
+  length_ = 0;
+}
+
+bool LoopDetector::Key::operator==(const Key& other) const
+{
+  return flags == other.flags &&
+         memcmp(registers, other.registers, sizeof(registers)) == 0;
+}
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstdint>
+
+#include "core/cpu.h"
+
+// Detects that a machine has entered an infinite loop, using Brent's cycle
+// detection on states sampled between runs. Bus::Write is a no-op and the
+// input switches don't change while the machine runs, so its future depends
+// only on the registers and the flags. A repeated state therefore proves that
+// the program never halts.
+//
+// States must be sampled after the same number of instructions each time, so
+// that the sampled sequence becomes periodic with the program.
+class LoopDetector
+{
+  public:
+    // Returns true if state has been seen before.
+    bool Check(const CPUBase::State& state);
+
+    void Reset();
+
+  private:
+    // Part of the state that determines the future of the machine
+    struct Key
+    {
+      uint8_t registers[8];
+      uint8_t flags;
+
+      bool operator==(const Key& other) const;
+    };
+
+  private:
+    Key saved_ = {};
+    bool has_saved_ = false;
+
+    // Brent's algorithm compares every state with the one saved at the last
+    // power of two.
+    uint64_t power_ = 1;
+    uint64_t length_ = 0;
+};
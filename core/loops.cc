@@ -0,0 +1,179 @@
+#include "core/alu.h"
+#include "core/loops.h"
+
+typedef DecodedInstruction::Handler Handler;
+
+static const uint8_t kPC = 0x07;
+
+static bool is_alu(Handler handler)
+{
+  return handler >= Handler::kADC;
+}
+
+static bool is_unary(Handler handler)
+{
+  return handler >= Handler::kNOT;
+}
+
+static bool reads_carry(Handler handler)
+{
+  return handler == Handler::kADC || handler == Handler::kSBC ||
+         handler == Handler::kRCR;
+}
+
+// Same as CPU::CheckCondition(), on the flags of an ALU result.
+static bool check_condition(uint8_t cond, uint16_t result)
+{
+  bool carry = (result >> 8) & 0x1;
+  bool zero = (result & 0xFF) == 0;
+  bool sign = (result >> 7) & 0x1;
+
+  switch (cond)
+  {
+    case 0b000: return true;
+    case 0b001: return zero;
+    case 0b010: return !sign;
+    case 0b011: return carry;
+    case 0b100: return !carry;
+    case 0b101: return sign;
+    case 0b110: return !zero;
+    default: return false;
+  }
+}
+
+// Fills the exit of every counter and carry. Each of the 512 states has one
+// successor, so following the chain from every state and recording the
+// outcome on the way back visits each state once.
+static void compute_exits(CountingLoop& loop, uint8_t cond)
+{
+  enum Mark : uint8_t { kUnknown, kVisiting, kDone };
+
+  const DecodedInstruction& op = loop.counter;
+  std::array<Mark, 512> marks = {};
+  std::vector<int> chain;
+
+  for (int start = 0; start < 512; ++start)
+  {
+    CountingLoop::Exit exit;
+    int state = start;
+
+    while (marks[state] == kUnknown)
+    {
+      uint8_t value = state & 0xFF;
+      bool carry = state >> 8;
+      uint16_t result = is_unary(op.handler) ?
+                        lookup_unary_alu(op.handler, carry, value) :
+                        lookup_binary_alu(op.handler, carry, value, op.Op2);
+
+      if (!check_condition(cond, result))
+      {
+        loop.exits[state].iterations = 1;
+        loop.exits[state].result = result;
+        marks[state] = kDone;
+        break;
+      }
+
+      marks[state] = kVisiting;
+      chain.push_back(state);
+
+      uint8_t next = op.WritesResult() ? result & 0xFF : value;
+      state = next | (result & 0x100);
+    }
+
+    // A chain that runs into itself never exits.
+    if (marks[state] == kDone) exit = loop.exits[state];
+
+    while (!chain.empty())
+    {
+      if (exit.iterations) ++exit.iterations;
+
+      loop.exits[chain.back()] = exit;
+      marks[chain.back()] = kDone;
+      chain.pop_back();
+    }
+  }
+}
+
+std::unique_ptr<CountingLoop> recognize_counting_loop(
+    const std::array<DecodedInstruction, ROM::kAddressSpaceSize>& program,
+    uint8_t entry)
+{
+  // Find the JMP that closes the loop.
+  std::vector<DecodedInstruction> body;
+  uint8_t pc = entry;
+
+  for (int size = 0; size < CountingLoop::kMaxSize; ++size)
+  {
+    body.push_back(program[pc++]);
+
+    if (body.back().ChangesControlFlow()) break;
+  }
+
+  const DecodedInstruction& jump = body.back();
+
+  if (jump.handler != Handler::kJMP || jump.Op2 != entry || body.size() < 2 ||
+      jump.cond == 0b000 || jump.cond == 0b111)
+  {
+    return nullptr;
+  }
+
+  const DecodedInstruction& counter = body[body.size() - 2];
+
+  if (!is_alu(counter.handler) || counter.Gs == kPC ||
+      (counter.WritesResult() && counter.Gd != counter.Gs) ||
+      (!is_unary(counter.handler) && !counter.HasImmediate()))
+  {
+    return nullptr;
+  }
+
+  std::unique_ptr<CountingLoop> loop(new CountingLoop);
+  loop->entry = entry;
+  loop->size = body.size();
+  loop->jump = jump.instruction;
+  loop->counter = counter;
+
+  // Registers written by the loop. The counter register is reserved even if
+  // the counter only sets flags, since it must not change under it.
+  bool written[8] = {};
+  written[counter.Gs] = true;
+
+  for (size_t i = 0; i + 2 < body.size(); ++i)
+  {
+    const DecodedInstruction& op = body[i];
+
+    if (op.handler == Handler::kNOP) continue;
+
+    if ((op.handler != Handler::kADD && op.handler != Handler::kSUB &&
+         op.handler != Handler::kXOR) || !op.WritesResult() ||
+        op.Gd != op.Gs || written[op.Gd])
+    {
+      return nullptr;
+    }
+
+    written[op.Gd] = true;
+    loop->accumulators.push_back(
+        { op.handler, op.Gd, op.Op2, op.HasImmediate() });
+  }
+
+  for (const CountingLoop::Accumulator& accumulator : loop->accumulators)
+  {
+    // The operand must be the same on every iteration. PC reads as the
+    // address after the instruction, which is constant too, but it is rare
+    // enough not to be worth the special case.
+    if (!accumulator.immediate &&
+        (written[accumulator.operand] || accumulator.operand == kPC))
+    {
+      return nullptr;
+    }
+  }
+
+  // Accumulators overwrite the carry the counter would read.
+  if (!loop->accumulators.empty() && reads_carry(counter.handler))
+  {
+    return nullptr;
+  }
+
+  compute_exits(*loop, jump.cond);
+
+  return loop;
+}
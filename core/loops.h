@@ -0,0 +1,72 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "core/decoder.h"
+#include "core/rom.h"
+
+// Loop that jumps back to its own first instruction and whose effect after
+// any number of iterations is known without executing it:
+//
+//   entry: ADD/SUB/XOR R, R, <invariant>   (any number, one per register)
+//          NOP                             (any number)
+//          <ALU> C, C, <immediate>         (or a unary operation, or no write)
+//          JMP <cond>, entry
+//
+// The counter C and the carry are the only state that decides when the loop
+// exits, so the exit of every starting counter and carry is computed once
+// when the loop is recognised. The accumulators have closed forms.
+struct CountingLoop
+{
+  // Longest loop recognised, the JMP included. A loop is then always a
+  // whole block.
+  static const int kMaxSize = 32;
+
+  // Register updated by the same operation on every iteration
+  struct Accumulator
+  {
+    DecodedInstruction::Handler handler;
+    uint8_t code;
+
+    // Immediate or register code, as in DecodedInstruction::Op2
+    uint8_t operand;
+    bool immediate;
+  };
+
+  // Outcome of running the loop from some counter and carry
+  struct Exit
+  {
+    // Number of iterations until the jump is not taken, 0 if it always is
+    uint16_t iterations = 0;
+
+    // Result of the last counter operation, as in core/alu.h
+    uint16_t result = 0;
+  };
+
+  uint8_t entry = 0x00;
+
+  // Number of instructions of one iteration, the JMP included
+  uint8_t size = 0;
+
+  // Raw JMP word, left in the instruction register when the loop exits
+  uint16_t jump = 0x0000;
+
+  DecodedInstruction counter;
+  std::vector<Accumulator> accumulators;
+
+  // Indexed by counter | carry << 8
+  std::array<Exit, 512> exits;
+
+  const Exit& GetExit(uint8_t counter_value, bool carry) const
+  {
+    return exits[counter_value | carry << 8];
+  }
+};
+
+// Returns the counting loop starting at entry, or nullptr if the instructions
+// there are not one.
+std::unique_ptr<CountingLoop> recognize_counting_loop(
+    const std::array<DecodedInstruction, ROM::kAddressSpaceSize>& program,
+    uint8_t entry);
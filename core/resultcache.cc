@@ -0,0 +1,229 @@
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/resultcache.h"
+
+static std::runtime_error cache_error(const std::string& what,
+                                      const std::string& path)
+{
+  return std::runtime_error("cache: " + what + " \"" + path + "\": " +
+                            strerror(errno));
+}
+
+// Exclusive lock on a file, shared with no other process while held. Threads
+// of one process share the lock, so they must also hold a mutex.
+class FileLock
+{
+  public:
+    explicit FileLock(int fd) : fd_(fd)
+    {
+      do
+      {
+        locked_ = flock(fd_, LOCK_EX) == 0;
+      } while (!locked_ && errno == EINTR);
+    }
+
+    ~FileLock() { Release(); }
+
+    FileLock(const FileLock&) = delete;
+    FileLock& operator=(const FileLock&) = delete;
+
+    bool Locked() const { return locked_; }
+
+    // Unlocks the file before the end of the scope, e.g. before closing it.
+    void Release()
+    {
+      if (locked_) flock(fd_, LOCK_UN);
+      locked_ = false;
+    }
+
+  private:
+    int fd_;
+    bool locked_;
+};
+
+ResultCache::ResultCache(const std::string& path, uint64_t slots)
+{
+  uint64_t count = 1;
+  while (count < slots) count <<= 1;
+
+  fd_ = open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ == -1)
+  {
+    throw cache_error("can't open a file", path);
+  }
+
+  // Another process may be creating or emptying the file.
+  FileLock lock(fd_);
+  if (!lock.Locked())
+  {
+    close(fd_);
+    throw cache_error("can't lock a file", path);
+  }
+
+  struct stat status;
+  Header header = {};
+
+  if (fstat(fd_, &status) == -1)
+  {
+    lock.Release();
+    close(fd_);
+    throw cache_error("can't open a file", path);
+  }
+
+  bool valid = static_cast<size_t>(status.st_size) >= sizeof(Header) &&
+               pread(fd_, &header, sizeof(header), 0) == sizeof(header) &&
+               memcmp(header.magic, "RLRC", 4) == 0 &&
+               header.version == kVersion && header.slots != 0 &&
+               (header.slots & (header.slots - 1)) == 0 &&
+               static_cast<uint64_t>(status.st_size) ==
+                   sizeof(Header) + header.slots * sizeof(Slot);
+
+  if (valid)
+  {
+    count = header.slots;
+  }
+
+  map_size_ = sizeof(Header) + count * sizeof(Slot);
+  mask_ = count - 1;
+
+  // Another version or a damaged file is emptied.
+  if (!valid && (ftruncate(fd_, 0) == -1 || ftruncate(fd_, map_size_) == -1))
+  {
+    lock.Release();
+    close(fd_);
+    throw cache_error("can't resize a file", path);
+  }
+
+  map_ = mmap(nullptr, map_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+  if (map_ == MAP_FAILED)
+  {
+    lock.Release();
+    close(fd_);
+    throw cache_error("can't map a file", path);
+  }
+
+  header_ = static_cast<Header*>(map_);
+  slots_ = reinterpret_cast<Slot*>(static_cast<char*>(map_) + sizeof(Header));
+
+  if (!valid)
+  {
+    memcpy(header_->magic, "RLRC", 4);
+    header_->version = kVersion;
+    header_->slots = count;
+  }
+}
+
+ResultCache::~ResultCache()
+{
+  munmap(map_, map_size_);
+  close(fd_);
+}
+
+bool ResultCache::Find(uint64_t program, const std::array<uint8_t, 2>& input,
+                       uint64_t budget, SweepResult& result)
+{
+  std::lock_guard<std::mutex> lock(mutex_);
+  Slot* home = Home(program, input, budget);
+
+  for (uint64_t probe = 0; probe < kMaxProbes; ++probe)
+  {
+    Slot slot = *At(home, probe);
+
+    if (slot.check == 0) return false;
+
+    if (slot.check == Checksum(slot) && slot.program == program &&
+        slot.budget == budget && slot.input[0] == input[0] &&
+        slot.input[1] == input[1])
+    {
+      result.input = input;
+      result.status = static_cast<Emulator::Status>(slot.status);
+      memcpy(result.registers, slot.registers, sizeof(result.registers));
+      result.flags = slot.flags;
+      result.executed = slot.executed;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void ResultCache::Insert(uint64_t program, uint64_t budget,
+                         const SweepResult& result)
+{
+  Slot slot = {};
+  slot.program = program;
+  slot.budget = budget;
+  slot.executed = result.executed;
+  slot.input[0] = result.input[0];
+  slot.input[1] = result.input[1];
+  slot.status = static_cast<uint8_t>(result.status);
+  slot.flags = result.flags;
+  memcpy(slot.registers, result.registers, sizeof(slot.registers));
+  slot.check = Checksum(slot);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+
+  // Two processes must not pick the same free slot. A result that can't be
+  // locked in is dropped.
+  FileLock file_lock(fd_);
+  if (!file_lock.Locked()) return;
+
+  Slot* home = Home(program, result.input, budget);
+  Slot* target = home;
+
+  // Slots that fail their checksum are taken as free, as no other process
+  // can be writing them.
+  for (uint64_t probe = 0; probe < kMaxProbes; ++probe)
+  {
+    Slot* candidate = At(home, probe);
+
+    if (candidate->check == 0 || candidate->check != Checksum(*candidate) ||
+        (candidate->program == program && candidate->budget == budget &&
+         candidate->input[0] == slot.input[0] &&
+         candidate->input[1] == slot.input[1]))
+    {
+      target = candidate;
+      break;
+    }
+  }
+
+  *target = slot;
+}
+
+uint32_t ResultCache::Checksum(const Slot& slot)
+{
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&slot);
+  uint32_t hash = 0x811C9DC5;
+
+  for (size_t byte = 0; byte < offsetof(Slot, check); ++byte)
+  {
+    hash = (hash ^ bytes[byte]) * 0x01000193;
+  }
+
+  return hash == 0 ? 1 : hash;
+}
+
+ResultCache::Slot* ResultCache::Home(uint64_t program,
+                                     const std::array<uint8_t, 2>& input,
+                                     uint64_t budget)
+{
+  uint64_t key = program ^ (input[0] << 8 | input[1]) ^
+                 budget * 0x9E3779B97F4A7C15;
+  key = (key ^ key >> 31) * 0xBF58476D1CE4E5B9;
+
+  return slots_ + ((key ^ key >> 29) & mask_);
+}
+
+ResultCache::Slot* ResultCache::At(Slot* home, uint64_t probe)
+{
+  return slots_ + ((home - slots_ + probe) & mask_);
+}
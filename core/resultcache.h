@@ -0,0 +1,89 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+#include "core/sweep.h"
+
+// Results of runs kept in a memory-mapped file, so that later processes can
+// use them instead of running the program again. A run is determined by the
+// program data, the input and the budget, and is found by ROM::Hash() of the
+// program with the input and the budget.
+//
+// The file is an open-addressing hash table of a fixed number of slots; a
+// result whose slots are all taken replaces the first of them. Processes can
+// share it: opening and inserting hold an exclusive flock() on the file, so a
+// file is only created or emptied by one process and no two write a slot at
+// once. Finding takes no lock. Slots carry a checksum instead, so a slot
+// half-written by another process reads as missing. Words are in the byte
+// order of the machine.
+class ResultCache
+{
+  public:
+    // Version of the results. A file of another version is emptied, so this
+    // must change whenever a change to the emulator changes any result.
+    static const uint32_t kVersion = 1;
+
+    // 40 MiB
+    static const uint64_t kDefaultSlots = 1 << 20;
+
+  public:
+    // Opens the file at path, creating it with slots (rounded up to a power of
+    // two) if needed.
+    ResultCache(const std::string& path, uint64_t slots = kDefaultSlots);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+  public:
+    // Fills result with the result of running the program with hash program
+    // for input with budget. Returns false if there is none.
+    bool Find(uint64_t program, const std::array<uint8_t, 2>& input,
+              uint64_t budget, SweepResult& result);
+
+    void Insert(uint64_t program, uint64_t budget, const SweepResult& result);
+
+  private:
+    struct Header
+    {
+      char magic[4];
+      uint32_t version;
+      uint64_t slots;
+    };
+
+    struct Slot
+    {
+      uint64_t program;
+      uint64_t budget;
+      uint64_t executed;
+      uint8_t input[2];
+      uint8_t status;
+      uint8_t flags;
+      uint8_t registers[8];
+
+      // Checksum of the fields above, 0 if the slot is free
+      uint32_t check;
+    };
+
+    // Slots a result may take from the one its key hashes to
+    static const uint64_t kMaxProbes = 8;
+
+  private:
+    static uint32_t Checksum(const Slot& slot);
+    Slot* Home(uint64_t program, const std::array<uint8_t, 2>& input,
+               uint64_t budget);
+    Slot* At(Slot* home, uint64_t probe);
+
+  private:
+    std::mutex mutex_;
+
+    int fd_;
+    void* map_;
+    size_t map_size_;
+
+    Header* header_;
+    Slot* slots_;
+    uint64_t mask_;
+};
@@ -14,6 +14,21 @@ void ROM::Input(uint8_t first, uint8_t second)
   input_switches_[1] = second;
 }
 
+uint64_t ROM::Hash() const
+{
+  uint64_t hash = 0xCBF29CE484222325;
+
+  for (uint16_t word : program_data_)
+  {
+    for (uint8_t byte : { word >> 8, word & 0xFF })
+    {
+      hash = (hash ^ byte) * 0x100000001B3;
+    }
+  }
+
+  return hash;
+}
+
 uint16_t ROM::ReadProgramData(uint8_t addr) const
 {
   if (addr < kProgramDataSize)
@@ -26,6 +41,14 @@ uint16_t ROM::ReadProgramData(uint8_t addr) const
   }
 }
 
+void ROM::WriteProgramData(uint8_t addr, uint16_t word)
+{
+  if (addr < kProgramDataSize)
+  {
+    program_data_[addr] = word;
+  }
+}
+
 uint8_t ROM::ReadInputSwitches(uint8_t addr) const
 {
   uint8_t data = 0x00;
@@ -9,6 +9,8 @@ class ROM
     static const int kProgramDataSize = 128;
     static const int kInputSwitchesSize = 16;
     static const int kUnusedSize = 112;
+    static const int kAddressSpaceSize = kProgramDataSize +
+                                         kInputSwitchesSize + kUnusedSize;
 
   public:
     ROM(const std::array<uint16_t, kProgramDataSize>& program = {},
@@ -20,6 +22,13 @@ class ROM
     uint8_t ReadUnused(uint8_t addr) const;
     void Input(uint8_t first, uint8_t second);
 
+    // Returns a 64-bit FNV-1a hash of the program data, which identifies the
+    // program regardless of the input.
+    uint64_t Hash() const;
+
+    // Replaces the word at addr. Addresses outside program data are ignored.
+    void WriteProgramData(uint8_t addr, uint16_t word);
+
   private:
     std::array<uint16_t, kProgramDataSize> program_data_;
     std::array<uint8_t, kInputSwitchesSize / 8> input_switches_;
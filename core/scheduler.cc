@@ -0,0 +1,170 @@
+#include <algorithm>
+
+#include "core/scheduler.h"
+
+// Machines a worker takes at a time
+static const size_t kSchedulerChunk = 64;
+
+void InstanceBus::Input(const uint8_t input[2])
+{
+  for (int i = 0; i < kInputWords; ++i)
+  {
+    if (input_[i].instruction != input[i]) input_[i] = decode(input[i]);
+  }
+}
+
+Scheduler::Scheduler(const ROM& rom, unsigned workers)
+    : next_(0), running_(0)
+{
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    program_[addr] = decode(addr < ROM::kProgramDataSize ?
+                            rom.ReadProgramData(addr) : 0x0000);
+  }
+
+  for (unsigned worker = 1; worker < workers; ++worker)
+  {
+    threads_.emplace_back(&Scheduler::Serve, this);
+  }
+}
+
+Scheduler::~Scheduler()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+
+  round_started_.notify_all();
+
+  for (std::thread& thread : threads_)
+  {
+    thread.join();
+  }
+}
+
+size_t Scheduler::Add(uint8_t first, uint8_t second)
+{
+  instances_.push_back(Instance());
+  Input(instances_.size() - 1, first, second);
+
+  return instances_.size() - 1;
+}
+
+void Scheduler::Input(size_t index, uint8_t first, uint8_t second)
+{
+  instances_[index].input[0] = first;
+  instances_[index].input[1] = second;
+}
+
+void Scheduler::Reset(size_t index)
+{
+  instances_[index].state = CPU::State();
+  instances_[index].executed = 0;
+}
+
+size_t Scheduler::Round(uint64_t quantum)
+{
+  return Round(quantum, UINT64_MAX);
+}
+
+void Scheduler::Run(uint64_t budget, uint64_t quantum)
+{
+  while (Round(quantum, budget))
+  {
+  }
+}
+
+size_t Scheduler::Round(uint64_t quantum, uint64_t budget)
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    quantum_ = quantum;
+    budget_ = budget;
+    next_ = 0;
+    running_ = 0;
+    finished_ = 0;
+    ++round_;
+  }
+
+  round_started_.notify_all();
+
+  InstanceBus bus(program_);
+  CPUType cpu(&bus);
+  Work(bus, cpu);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  round_finished_.wait(lock, [this]()
+  {
+    return finished_ == threads_.size();
+  });
+
+  return running_;
+}
+
+void Scheduler::Serve()
+{
+  InstanceBus bus(program_);
+  CPUType cpu(&bus);
+  uint64_t round = 0;
+
+  for (;;)
+  {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      round_started_.wait(lock, [&]()
+      {
+        return stopping_ || round_ != round;
+      });
+
+      if (stopping_) return;
+      round = round_;
+    }
+
+    Work(bus, cpu);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ++finished_;
+    }
+
+    round_finished_.notify_one();
+  }
+}
+
+void Scheduler::Work(InstanceBus& bus, CPUType& cpu)
+{
+  size_t still_running = 0;
+
+  for (size_t begin = next_.fetch_add(kSchedulerChunk);
+       begin < instances_.size(); begin = next_.fetch_add(kSchedulerChunk))
+  {
+    size_t end = std::min(begin + kSchedulerChunk, instances_.size());
+
+    for (size_t index = begin; index < end; ++index)
+    {
+      Instance& instance = instances_[index];
+
+      if (instance.state.halted || instance.executed >= budget_) continue;
+
+      bus.Input(instance.input);
+      bus.StartClock();
+      cpu.SetState(instance.state);
+
+      instance.executed += cpu.Run(std::min(quantum_,
+                                            budget_ - instance.executed));
+      instance.state = cpu.GetState();
+
+      if (bus.Stopped())
+      {
+        instance.state.halted = true;
+      }
+      else if (instance.executed < budget_)
+      {
+        ++still_running;
+      }
+    }
+  }
+
+  running_ += still_running;
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "core/blockcache.h"
+#include "core/cpu.h"
+#include "core/rom.h"
+
+// Bus of the machines run by Scheduler. Each worker thread has one, which
+// reads the decoded program shared by all of them and holds only the decoded
+// input switch words of the machine it runs. It only offers what
+// BasicCPU::Run() needs.
+class InstanceBus
+{
+  public:
+    explicit InstanceBus(const BlockCache::Program& program)
+        : program_(program)
+    {
+      for (int i = 0; i < kInputWords; ++i)
+      {
+        input_[i] = program[ROM::kProgramDataSize + i];
+      }
+    }
+
+  public:
+    // Makes the input switches of the bus those of a machine.
+    void Input(const uint8_t input[2]);
+
+    uint16_t Read(uint8_t addr) const { return Fetch(addr).instruction; }
+    void Write(uint8_t, uint8_t) {}
+
+    const DecodedInstruction& Fetch(uint8_t addr) const
+    {
+      uint8_t input = addr - ROM::kProgramDataSize;
+      return input < kInputWords ? input_[input] : program_[addr];
+    }
+
+    void StopClock() { stopped_ = true; }
+    bool Stopped() const { return stopped_; }
+    void StartClock() { stopped_ = false; }
+
+  private:
+    static const int kInputWords = ROM::kInputSwitchesSize / 8;
+
+    const BlockCache::Program& program_;
+    DecodedInstruction input_[kInputWords];
+    bool stopped_ = false;
+};
+
+// Runs many machines with one program. The program is decoded once and shared,
+// and each machine is only its CPU state, kept with the others in one
+// contiguous array. Machines are stepped in turns of a fixed number of
+// instructions, in order, and a turn of every machine can be spread over
+// worker threads, which wait for the next round for the lifetime of the
+// scheduler.
+class Scheduler
+{
+  public:
+    // Default number of instructions a machine executes in one turn
+    static const uint64_t kQuantum = 4096;
+
+    struct Instance
+    {
+      // halted is set once the machine executes HALT.
+      CPU::State state;
+
+      // Values of the input switches at 0x80 and 0x81
+      uint8_t input[2];
+
+      // Number of instructions executed since reset
+      uint64_t executed;
+    };
+
+    typedef BasicCPU<InstanceBus, NoHooks> CPUType;
+
+  public:
+    // Rounds are spread over workers threads, the calling one included.
+    explicit Scheduler(const ROM& rom, unsigned workers = 1);
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+  public:
+    // Adds a machine in the reset state with the given input switches.
+    // Returns its index.
+    size_t Add(uint8_t first, uint8_t second);
+
+    void Input(size_t index, uint8_t first, uint8_t second);
+    void Reset(size_t index);
+
+    // Gives every machine that has not halted a turn of quantum instructions.
+    // Returns the number of machines that have not halted.
+    size_t Round(uint64_t quantum = kQuantum);
+
+    // Runs rounds until every machine has halted or executed budget
+    // instructions since reset.
+    void Run(uint64_t budget, uint64_t quantum = kQuantum);
+
+    const Instance& Get(size_t index) const { return instances_[index]; }
+    size_t Size() const { return instances_.size(); }
+
+  private:
+    // Same as Round(), but machines stop at budget instructions and only
+    // those below it are counted.
+    size_t Round(uint64_t quantum, uint64_t budget);
+
+    // Runs the rounds of one worker thread until the scheduler is destroyed.
+    void Serve();
+
+    // Gives turns of the current round to the machines of chunks taken from
+    // next_ until none is left, and adds the machines still running to
+    // running_.
+    void Work(InstanceBus& bus, CPUType& cpu);
+
+  private:
+    BlockCache::Program program_;
+    std::vector<Instance> instances_;
+
+    std::vector<std::thread> threads_;
+
+    // Guards the fields below. Rounds are numbered, and a worker starts one
+    // when round_ changes.
+    std::mutex mutex_;
+    std::condition_variable round_started_;
+    std::condition_variable round_finished_;
+    uint64_t round_ = 0;
+    size_t finished_ = 0;
+    bool stopping_ = false;
+
+    // Current round
+    uint64_t quantum_ = 0;
+    uint64_t budget_ = 0;
+    std::atomic<size_t> next_;
+    std::atomic<size_t> running_;
+};
@@ -0,0 +1,386 @@
+#include <cstring>
+
+#include "core/slicedcpu.h"
+
+typedef DecodedInstruction::Handler Handler;
+typedef SlicedCPU::Slice Slice;
+typedef SlicedCPU::Byte Byte;
+
+static Byte splat(uint8_t value)
+{
+  Byte b;
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    b.bits[bit] = -Slice((value >> bit) & 0x1);
+  }
+
+  return b;
+}
+
+// Returns the byte of lane.
+static uint8_t extract(const Byte& b, int lane)
+{
+  uint8_t value = 0x00;
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    value |= ((b.bits[bit] >> lane) & 0x1) << bit;
+  }
+
+  return value;
+}
+
+static void insert(Byte& b, int lane, uint8_t value)
+{
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    b.bits[bit] &= ~(Slice(1) << lane);
+    b.bits[bit] |= Slice((value >> bit) & 0x1) << lane;
+  }
+}
+
+// Returns the mask of lanes in which b equals value.
+static Slice match(const Byte& b, uint8_t value)
+{
+  Slice mask = ~Slice(0);
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    mask &= ~(b.bits[bit] ^ -Slice((value >> bit) & 0x1));
+  }
+
+  return mask;
+}
+
+// Copies value into lanes of mask of destination.
+static void assign(Byte& destination, const Byte& value, Slice mask)
+{
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    destination.bits[bit] = (value.bits[bit] & mask) |
+                            (destination.bits[bit] & ~mask);
+  }
+}
+
+static void assign(Slice& destination, Slice value, Slice mask)
+{
+  destination = (value & mask) | (destination & ~mask);
+}
+
+static int first_lane(Slice mask)
+{
+#if defined(__GNUC__)
+  return __builtin_ctzll(mask);
+#else
+  int lane = 0;
+  while (!((mask >> lane) & 0x1)) ++lane;
+
+  return lane;
+#endif
+}
+
+static bool is_input(uint8_t addr)
+{
+  return addr == 0x80 || addr == 0x81;
+}
+
+// Ripple-carry adder. Carry holds the carry in and receives the carry out.
+static Byte add(const Byte& x, const Byte& y, Slice& carry)
+{
+  Byte sum;
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    Slice half = x.bits[bit] ^ y.bits[bit];
+    sum.bits[bit] = half ^ carry;
+    carry = (x.bits[bit] & y.bits[bit]) | (carry & half);
+  }
+
+  return sum;
+}
+
+// Ripple-borrow subtractor. Borrow holds the borrow in and receives the
+// borrow out, which is the CY flag of SUB and SBC.
+static Byte subtract(const Byte& x, const Byte& y, Slice& borrow)
+{
+  Byte difference;
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    Slice half = x.bits[bit] ^ y.bits[bit];
+    difference.bits[bit] = half ^ borrow;
+    borrow = (~x.bits[bit] & y.bits[bit]) | (~half & borrow);
+  }
+
+  return difference;
+}
+
+static Slice check_condition(const SlicedCPU::State& s, uint8_t cond)
+{
+  switch (cond)
+  {
+    case 0b000: return ~Slice(0);
+    case 0b001: return s.zero;
+    case 0b010: return ~s.sign;
+    case 0b011: return s.carry;
+    case 0b100: return ~s.carry;
+    case 0b101: return s.sign;
+    case 0b110: return ~s.zero;
+    default: return 0;
+  }
+}
+
+// Reads the low byte of the word at every address in lanes of mask. Memory
+// is the same for every lane except the input switches, so LOAD from a
+// register gathers one lane at a time.
+static Byte gather(const SlicedCPU::State& s, const Byte& addresses,
+                   Slice mask, const uint8_t* memory)
+{
+  Byte values = splat(0x00);
+
+  for (Slice lanes = mask; lanes; lanes &= lanes - 1)
+  {
+    int lane = first_lane(lanes);
+    uint8_t addr = extract(addresses, lane);
+    uint8_t value = is_input(addr) ? extract(s.input[addr - 0x80], lane) :
+                                     memory[addr];
+    insert(values, lane, value);
+  }
+
+  return values;
+}
+
+static Byte read(const SlicedCPU::State& s, uint8_t addr,
+                 const uint8_t* memory)
+{
+  return is_input(addr) ? s.input[addr - 0x80] : splat(memory[addr]);
+}
+
+static void execute_alu(SlicedCPU::State& s, const DecodedInstruction& op,
+                        Slice mask)
+{
+  const Byte& x = s.registers[op.Gs];
+  Byte y = op.HasImmediate() ? splat(op.Op2) : s.registers[op.Op2];
+  Byte result;
+  Slice carry = 0;
+
+  switch (op.handler)
+  {
+    case Handler::kADC: carry = s.carry; result = add(x, y, carry); break;
+    case Handler::kADD: result = add(x, y, carry); break;
+    case Handler::kSBC: carry = s.carry; result = subtract(x, y, carry); break;
+    case Handler::kSUB: result = subtract(x, y, carry); break;
+    case Handler::kAND:
+      for (int bit = 0; bit < 8; ++bit)
+      {
+        result.bits[bit] = x.bits[bit] & y.bits[bit];
+      }
+      break;
+    case Handler::kOR:
+      for (int bit = 0; bit < 8; ++bit)
+      {
+        result.bits[bit] = x.bits[bit] | y.bits[bit];
+      }
+      break;
+    case Handler::kXOR:
+      for (int bit = 0; bit < 8; ++bit)
+      {
+        result.bits[bit] = x.bits[bit] ^ y.bits[bit];
+      }
+      break;
+    case Handler::kNOT:
+      for (int bit = 0; bit < 8; ++bit) result.bits[bit] = ~x.bits[bit];
+      break;
+    default:
+      // Shifts and rotations only renumber the bits.
+      for (int bit = 0; bit < 7; ++bit) result.bits[bit] = x.bits[bit + 1];
+
+      switch (op.handler)
+      {
+        case Handler::kROR: result.bits[7] = x.bits[0]; break;
+        case Handler::kSHR: result.bits[7] = 0; carry = x.bits[0]; break;
+        case Handler::kRCR: default:
+          result.bits[7] = s.carry;
+          carry = x.bits[0];
+          break;
+      }
+      break;
+  }
+
+  Slice nonzero = 0;
+  for (int bit = 0; bit < 8; ++bit) nonzero |= result.bits[bit];
+
+  assign(s.carry, carry, mask);
+  assign(s.zero, ~nonzero, mask);
+  assign(s.sign, result.bits[7], mask);
+
+  if (op.WritesResult()) assign(s.registers[op.Gd], result, mask);
+}
+
+// Executes op in the lanes of mask.
+static void execute(SlicedCPU::State& s, const DecodedInstruction& op,
+                    Slice mask, const uint8_t* memory)
+{
+  Byte* r = s.registers;
+
+  assign(s.instruction_low, splat(op.instruction & 0xFF), mask);
+  assign(s.instruction_high, splat(op.instruction >> 8), mask);
+
+  // As in CPU, PC is incremented before the operands are read. Taken CALL and
+  // JMP overwrite it.
+  Slice carry = mask;
+  for (int bit = 0; bit < 8; ++bit)
+  {
+    Slice sum = r[CPU::kPC].bits[bit] ^ carry;
+    carry &= r[CPU::kPC].bits[bit];
+    r[CPU::kPC].bits[bit] = sum;
+  }
+
+  switch (op.handler)
+  {
+    case Handler::kHALT:
+      s.halted |= mask;
+      break;
+    case Handler::kNOP: case Handler::kSTORE: case Handler::kSTOREI:
+      break;
+    case Handler::kLOAD:
+      if (op.Gs > CPU::kM)
+      {
+        assign(r[op.Gd], gather(s, r[op.Gs], mask, memory), mask);
+      }
+      break;
+    case Handler::kLOADI:
+      assign(r[op.Gd], read(s, op.Op2, memory), mask);
+      break;
+    case Handler::kCALL:
+    {
+      Slice taken = mask & check_condition(s, op.cond);
+      assign(r[CPU::kL], r[CPU::kPC], taken);
+      assign(r[CPU::kPC], splat(op.Op2), taken);
+      break;
+    }
+    case Handler::kJMP:
+      assign(r[CPU::kPC], splat(op.Op2), mask & check_condition(s, op.cond));
+      break;
+    case Handler::kMOVI:
+      assign(r[op.Gd], splat(op.Op2), mask & check_condition(s, op.cond));
+      break;
+    case Handler::kMOV:
+      assign(r[op.Gd], r[op.Gs], mask);
+      break;
+    default:
+      execute_alu(s, op, mask);
+      break;
+  }
+}
+
+SlicedCPU::SlicedCPU(const ROM& rom)
+{
+  for (int addr = 0; addr < ROM::kAddressSpaceSize; ++addr)
+  {
+    uint16_t word = addr < ROM::kProgramDataSize ?
+                    rom.ReadProgramData(addr) : 0x0000;
+
+    program_[addr] = decode(word);
+    memory_[addr] = word & 0x00FF;
+  }
+
+  state_.input[0] = splat(rom.ReadInputSwitches(0x80));
+  state_.input[1] = splat(rom.ReadInputSwitches(0x81));
+
+  Reset();
+}
+
+void SlicedCPU::Input(int lane, uint8_t first, uint8_t second)
+{
+  insert(state_.input[0], lane, first);
+  insert(state_.input[1], lane, second);
+}
+
+uint64_t SlicedCPU::Run(uint64_t budget)
+{
+  State& s = state_;
+
+  uint64_t step = 0;
+  for (; step < budget; ++step)
+  {
+    Slice pending = ~s.halted;
+
+    if (!pending) break;
+
+    do
+    {
+      int lane = first_lane(pending);
+      uint8_t pc = extract(s.registers[CPU::kPC], lane);
+      Slice mask = pending & match(s.registers[CPU::kPC], pc);
+      DecodedInstruction op;
+
+      if (is_input(pc))
+      {
+        // Lanes at the same input switch word may still hold different
+        // instructions there.
+        uint8_t word = extract(s.input[pc - 0x80], lane);
+        mask &= match(s.input[pc - 0x80], word);
+        op = decode(word);
+      }
+      else
+      {
+        op = program_[pc];
+      }
+
+      execute(s, op, mask, memory_);
+
+      if (op.handler == Handler::kHALT)
+      {
+        for (Slice lanes = mask; lanes; lanes &= lanes - 1)
+        {
+          retired_[first_lane(lanes)] = steps_ + step + 1;
+        }
+      }
+
+      pending &= ~mask;
+    } while (pending);
+  }
+
+  steps_ += step;
+
+  return step;
+}
+
+void SlicedCPU::Reset()
+{
+  for (Byte& r : state_.registers) r = splat(0x00);
+
+  state_.sign = 0;
+  state_.zero = 0;
+  state_.carry = 0;
+  state_.halted = 0;
+  state_.instruction_low = splat(0x00);
+  state_.instruction_high = splat(0x00);
+
+  steps_ = 0;
+  memset(retired_, 0, sizeof(retired_));
+}
+
+uint8_t SlicedCPU::GetRegister(int lane, uint8_t code) const
+{
+  return extract(state_.registers[code & 0x07], lane);
+}
+
+bool SlicedCPU::GetFlag(int lane, CPU::Flag flag) const
+{
+  switch (flag)
+  {
+    case CPU::Flag::kCY: return state_.carry >> lane & 0x1;
+    case CPU::Flag::kZ: return state_.zero >> lane & 0x1;
+    case CPU::Flag::kS: return state_.sign >> lane & 0x1;
+    default: return false;
+  }
+}
+
+uint16_t SlicedCPU::GetInstructionRegister(int lane) const
+{
+  return extract(state_.instruction_high, lane) << 8 |
+         extract(state_.instruction_low, lane);
+}
+
+uint64_t SlicedCPU::GetExecuted(int lane) const
+{
+  return Halted(lane) ? retired_[lane] : steps_;
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+
+#include "core/blockcache.h"
+#include "core/cpu.h"
+#include "core/rom.h"
+
+// Runs kLanes machines with the same program in bit-sliced form: every bit of
+// every register and flag is a 64-bit word holding that bit of all machines.
+// The ALU becomes a network of bitwise operations (ripple-carry adders for
+// ADD/ADC/SUB/SBC), conditions become lane masks, and one host instruction
+// evaluates a gate of all 64 machines at once.
+//
+// As in LaneCPU, lanes at the same PC execute together and diverged lanes are
+// executed in turn under a mask.
+class SlicedCPU
+{
+  public:
+    static const int kLanes = 64;
+
+    // One bit of every lane
+    typedef uint64_t Slice;
+
+    // One byte of every lane, least significant bit first
+    struct Byte
+    {
+      Slice bits[8];
+    };
+
+    struct State
+    {
+      // Indexed by CPU::RegisterCode
+      Byte registers[8];
+
+      Slice sign;
+      Slice zero;
+      Slice carry;
+      Slice halted;
+
+      // Last executed instruction
+      Byte instruction_low;
+      Byte instruction_high;
+
+      // Values of the input switches at 0x80 and 0x81
+      Byte input[2];
+    };
+
+  public:
+    SlicedCPU(const ROM& rom = ROM());
+
+  public:
+    // Sets the input switches of lane.
+    void Input(int lane, uint8_t first, uint8_t second);
+
+    // Executes up to budget instructions on every lane that has not halted.
+    // Returns the number of lockstep steps, i.e. the number of instructions
+    // executed by the lane that ran longest.
+    uint64_t Run(uint64_t budget);
+
+    // Resets the state of every lane except the input switches.
+    void Reset();
+
+    bool Halted(int lane) const { return state_.halted >> lane & 0x1; }
+    bool AllHalted() const { return state_.halted == ~Slice(0); }
+
+    uint8_t GetRegister(int lane, uint8_t code) const;
+    bool GetFlag(int lane, CPU::Flag flag) const;
+    uint16_t GetInstructionRegister(int lane) const;
+
+    // Returns the number of instructions lane has executed since Reset().
+    uint64_t GetExecuted(int lane) const;
+
+  private:
+    State state_;
+
+    // Decoded copy of every word that is the same for all lanes. The input
+    // switch words are decoded per lane.
+    BlockCache::Program program_;
+
+    // Low bytes of every word, for LOAD
+    uint8_t memory_[ROM::kAddressSpaceSize];
+
+    // Steps executed since Reset(), and the step on which each lane halted.
+    uint64_t steps_ = 0;
+    uint64_t retired_[kLanes];
+};
@@ -0,0 +1,96 @@
+#include <vector>
+
+#include "core/specializer.h"
+
+// Returns the words of a program that sets every register except PC and the
+// flags to their values in state without executing anything else.
+static std::vector<uint16_t> emit_setup(const CPU::State& state)
+{
+  std::vector<uint16_t> words;
+  uint8_t flags = CPU::PackFlags(state);
+
+  if (flags)
+  {
+    bool carry = flags >> static_cast<int>(CPU::Flag::kCY) & 0x1;
+    bool zero = flags >> static_cast<int>(CPU::Flag::kZ) & 0x1;
+    bool sign = flags >> static_cast<int>(CPU::Flag::kS) & 0x1;
+    uint8_t result = zero ? 0x00 : sign ? 0x80 : 0x01;
+
+    // 0xFF + result + 1 carries out, result + 0x00 does not. ALU immediates
+    // are too narrow for the operands, so they go through A and B. The sum
+    // only sets the flags, and MOVI leaves them alone afterwards.
+    uint8_t first = carry ? 0xFF : result;
+    uint8_t second = carry ? result + 1 : 0x00;
+
+    words.push_back(encode(Operation::kMOVI, { CPU::kA, 0, first, 0, false, false }));
+    words.push_back(encode(Operation::kMOVI, { CPU::kB, 0, second, 0, false, false }));
+    words.push_back(encode(Operation::kADD,
+                           { 0, CPU::kA, CPU::kB, 0, false, false }));
+  }
+
+  for (uint8_t code = CPU::kA; code < CPU::kPC; ++code)
+  {
+    // Registers are 0 after reset, except A and B if they held the flag
+    // operands.
+    if (state.registers[code] || (flags && code <= CPU::kB))
+    {
+      words.push_back(encode(Operation::kMOVI, { code, 0,
+                                                 state.registers[code], 0,
+                                                 false, false }));
+    }
+  }
+
+  return words;
+}
+
+Emulator::Status specialize(const ROM& rom, uint64_t budget,
+                            Specialization& specialization)
+{
+  std::unique_ptr<Engine> engine = Engine::Create(Engine::Fastest());
+  uint64_t executed;
+
+  engine->Load(rom);
+
+  Emulator::Status status = Emulator::Run(*engine, budget, executed);
+  if (status != Emulator::Status::kHalted) return status;
+
+  const CPU::State& state = engine->GetState();
+
+  specialization.state = state;
+  specialization.executed = executed;
+
+  for (int addr = 0; addr < ROM::kProgramDataSize; ++addr)
+  {
+    specialization.program[addr] = rom.ReadProgramData(addr);
+  }
+
+  // HALT is the only instruction that stops the machine, and input switch
+  // words can't encode it, so it was executed from program data.
+  uint8_t halt = state.registers[CPU::kPC] - 1;
+  std::vector<uint16_t> setup = emit_setup(state);
+  std::array<uint16_t, ROM::kProgramDataSize> program = {};
+
+  if (halt == 0 && !setup.empty()) return Emulator::Status::kHalted;
+
+  // The setup runs from 0 and jumps to the HALT, unless the HALT is in its
+  // way, in which case it runs from just after the HALT.
+  uint8_t start = halt < setup.size() ? halt + 1 : 0;
+  uint8_t addr = start;
+
+  if (start)
+  {
+    program[0] = encode(Operation::kJMP, { 0, 0, start, 0, false, false });
+  }
+
+  for (uint16_t word : setup) program[addr++] = word;
+
+  if (addr != halt)
+  {
+    program[addr] = encode(Operation::kJMP, { 0, 0, halt, 0, false, false });
+  }
+
+  program[halt] = state.instruction;
+  specialization.program = program;
+
+  return Emulator::Status::kHalted;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include <array>
+
+#include "core/emulator.h"
+
+// Program evaluated ahead of time for the input switches of its ROM.
+struct Specialization
+{
+  // State in which the program halts
+  CPU::State state = {};
+
+  // Number of instructions executed until HALT
+  uint64_t executed = 0;
+
+  // Shorter program halting in the same state (registers, flags, PC and
+  // instruction register), or the original program if none exists. Only a
+  // program that halts on its first instruction and leaves registers or flags
+  // set can't be shortened.
+  std::array<uint16_t, ROM::kProgramDataSize> program = {};
+};
+
+// Evaluates the program of rom from reset. The input switches are the only
+// values the program does not define itself, so with them fixed every value
+// is a constant and constant propagation is the same as execution. Returns
+// kHalted and fills specialization if the program halts within budget
+// instructions, and kLooped or kBudgetExhausted otherwise.
+Emulator::Status specialize(const ROM& rom, uint64_t budget,
+                            Specialization& specialization);
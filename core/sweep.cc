@@ -0,0 +1,282 @@
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <thread>
+
+#include "core/sweep.h"
+#include "core/lanecpu.h"
+#include "core/slicedcpu.h"
+#include "core/resultcache.h"
+
+// Inputs a worker takes at a time. Small enough to balance programs whose run
+// time depends on the input, large enough for workers to rarely meet on the
+// counter.
+static const size_t kSweepChunk = 64;
+
+static void write_word(std::ostream& output, uint64_t word, int bytes)
+{
+  for (int byte = bytes - 1; byte >= 0; --byte)
+  {
+    output.put(static_cast<char>(word >> (byte * 8)));
+  }
+}
+
+const char* status_name(Emulator::Status status)
+{
+  switch (status)
+  {
+    case Emulator::Status::kHalted: return "halted";
+    case Emulator::Status::kLooped: return "looped";
+    case Emulator::Status::kBudgetExhausted: default: return "budget";
+  }
+}
+
+std::vector<std::array<uint8_t, 2>> all_inputs()
+{
+  std::vector<std::array<uint8_t, 2>> inputs(1 << 16);
+
+  for (size_t index = 0; index < inputs.size(); ++index)
+  {
+    inputs[index][0] = index >> 8;
+    inputs[index][1] = index & 0xFF;
+  }
+
+  return inputs;
+}
+
+static void run_input(Engine& machine, const std::array<uint8_t, 2>& input,
+                      uint64_t budget, SweepResult& result)
+{
+  machine.Reset();
+  machine.Input(input[0], input[1]);
+
+  result.input = input;
+  result.status = Emulator::Run(machine, budget, result.executed);
+
+  const CPU::State& state = machine.GetState();
+  std::copy(state.registers, state.registers + 8, result.registers);
+  result.flags = CPU::PackFlags(state);
+}
+
+// Runs the count (at most LockstepCPU::kLanes) inputs at indices together on
+// lanes. Spare lanes repeat the first input.
+template <class LockstepCPU>
+static void run_lanes(LockstepCPU& lanes, Engine& machine,
+                      const std::vector<std::array<uint8_t, 2>>& inputs,
+                      const size_t* indices, size_t count, uint64_t budget,
+                      std::vector<SweepResult>& results)
+{
+  for (int lane = 0; lane < LockstepCPU::kLanes; ++lane)
+  {
+    const std::array<uint8_t, 2>& input =
+        inputs[indices[static_cast<size_t>(lane) < count ? lane : 0]];
+
+    lanes.Input(lane, input[0], input[1]);
+  }
+
+  uint64_t quantum = Emulator::kRunQuantum;
+
+  lanes.Reset();
+  lanes.Run(std::min(budget, quantum));
+
+  for (size_t lane = 0; lane < count; ++lane)
+  {
+    SweepResult& result = results[indices[lane]];
+
+    if (!lanes.Halted(lane))
+    {
+      run_input(machine, inputs[indices[lane]], budget, result);
+      continue;
+    }
+
+    result.input = inputs[indices[lane]];
+    result.status = Emulator::Status::kHalted;
+    result.executed = lanes.GetExecuted(lane);
+
+    for (uint8_t code = 0; code < 8; ++code)
+    {
+      result.registers[code] = lanes.GetRegister(lane, code);
+    }
+
+    result.flags = 0x00;
+    for (CPU::Flag flag : { CPU::Flag::kCY, CPU::Flag::kZ, CPU::Flag::kS })
+    {
+      result.flags |= lanes.GetFlag(lane, flag) << static_cast<int>(flag);
+    }
+  }
+}
+
+// Runs the count inputs at indices on lanes, LockstepCPU::kLanes at a time.
+template <class LockstepCPU>
+static void run_lockstep(LockstepCPU& lanes, Engine& machine,
+                         const std::vector<std::array<uint8_t, 2>>& inputs,
+                         const size_t* indices, size_t count,
+                         uint64_t budget, std::vector<SweepResult>& results)
+{
+  for (size_t first = 0; first < count; first += LockstepCPU::kLanes)
+  {
+    run_lanes(lanes, machine, inputs, indices + first,
+              std::min<size_t>(count - first, LockstepCPU::kLanes), budget,
+              results);
+  }
+}
+
+std::vector<SweepResult> sweep(
+    const ROM& rom, const std::vector<std::array<uint8_t, 2>>& inputs,
+    Engine::Type engine, uint64_t budget, unsigned workers,
+    ResultCache* cache, SweepMode mode)
+{
+  std::vector<SweepResult> results(inputs.size());
+  uint64_t program = rom.Hash();
+  std::atomic<size_t> next(0);
+
+  if (workers == 0) workers = std::thread::hardware_concurrency();
+  if (workers == 0) workers = 1;
+
+  // What each worker threw, if anything. The others stop at their next chunk
+  // and the first exception is rethrown here.
+  std::vector<std::exception_ptr> errors(workers);
+  std::atomic<bool> failed(false);
+
+  auto work = [&](unsigned worker)
+  {
+    try
+    {
+      std::unique_ptr<Engine> machine = Engine::Create(engine);
+      machine->Load(rom);
+
+      std::unique_ptr<LaneCPU> lanes;
+      if (mode == SweepMode::kLanes) lanes.reset(new LaneCPU(rom));
+
+      std::unique_ptr<SlicedCPU> sliced;
+      if (mode == SweepMode::kSliced) sliced.reset(new SlicedCPU(rom));
+
+      // Inputs of the chunk not found in cache
+      size_t pending[kSweepChunk];
+
+      for (size_t begin = next.fetch_add(kSweepChunk);
+           begin < inputs.size() && !failed;
+           begin = next.fetch_add(kSweepChunk))
+      {
+        size_t end = std::min(begin + kSweepChunk, inputs.size());
+        size_t count = 0;
+
+        for (size_t index = begin; index < end; ++index)
+        {
+          if (!(cache && cache->Find(program, inputs[index], budget,
+                                     results[index])))
+          {
+            pending[count++] = index;
+          }
+        }
+
+        if (lanes)
+        {
+          run_lockstep(*lanes, *machine, inputs, pending, count, budget,
+                       results);
+        }
+        else if (sliced)
+        {
+          run_lockstep(*sliced, *machine, inputs, pending, count, budget,
+                       results);
+        }
+        else
+        {
+          for (size_t first = 0; first < count; ++first)
+          {
+            run_input(*machine, inputs[pending[first]], budget,
+                      results[pending[first]]);
+          }
+        }
+
+        if (cache)
+        {
+          for (size_t first = 0; first < count; ++first)
+          {
+            cache->Insert(program, budget, results[pending[first]]);
+          }
+        }
+      }
+    }
+    catch (...)
+    {
+      errors[worker] = std::current_exception();
+      failed = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  try
+  {
+    for (unsigned worker = 1; worker < workers; ++worker)
+    {
+      threads.emplace_back(work, worker);
+    }
+  }
+  catch (...)
+  {
+    failed = true;
+
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+
+    throw;
+  }
+
+  work(0);
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (const std::exception_ptr& error : errors)
+  {
+    if (error) std::rethrow_exception(error);
+  }
+
+  return results;
+}
+
+void write_sweep(std::ostream& output, const std::vector<SweepResult>& results)
+{
+  output.write("RLSW", 4);
+  write_word(output, results.size(), 4);
+
+  for (const SweepResult& result : results)
+  {
+    output.put(result.input[0]);
+    output.put(result.input[1]);
+    output.put(static_cast<char>(result.status));
+    output.put(result.flags);
+    output.write(reinterpret_cast<const char*>(result.registers),
+                 sizeof(result.registers));
+    write_word(output, result.executed, 8);
+  }
+}
+
+void write_sweep_csv(std::ostream& output,
+                     const std::vector<SweepResult>& results)
+{
+  output << "first,second,status,executed,A,B,C,D,M,S,L,PC,CY,Z,S_flag\n";
+
+  for (const SweepResult& result : results)
+  {
+    output << +result.input[0] << ',' << +result.input[1] << ',' <<
+              status_name(result.status) << ',' << result.executed;
+
+    for (uint8_t value : result.registers)
+    {
+      output << ',' << +value;
+    }
+
+    for (CPU::Flag flag : { CPU::Flag::kCY, CPU::Flag::kZ, CPU::Flag::kS })
+    {
+      output << ',' << (result.flags >> static_cast<int>(flag) & 0x1);
+    }
+
+    output << '\n';
+  }
+}
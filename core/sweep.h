@@ -0,0 +1,67 @@
+#pragma once
+#include <array>
+#include <ostream>
+#include <vector>
+
+#include "core/emulator.h"
+
+class ResultCache;
+
+// Outcome of running a program for one input
+struct SweepResult
+{
+  // Values of the input switches at 0x80 and 0x81
+  std::array<uint8_t, 2> input = {};
+
+  Emulator::Status status = Emulator::Status::kHalted;
+
+  // Final state
+  uint8_t registers[8] = {};
+  uint8_t flags = 0x00;
+
+  uint64_t executed = 0;
+};
+
+// How sweep() runs the inputs
+enum class SweepMode
+{
+  // One at a time on the engine
+  kScalar,
+
+  // LaneCPU::kLanes at a time in lockstep on a LaneCPU. Inputs whose lane does
+  // not halt within Emulator::kRunQuantum instructions are run again on the
+  // engine, which tells a loop from an exhausted budget.
+  kLanes,
+
+  // SlicedCPU::kLanes at a time on a SlicedCPU, as kLanes
+  kSliced
+};
+
+// Returns "halted", "looped" or "budget".
+const char* status_name(Emulator::Status status);
+
+// Returns every input, first << 8 | second being the index of each.
+std::vector<std::array<uint8_t, 2>> all_inputs();
+
+// Runs the program of rom from reset for each of inputs, as Emulator::Run()
+// does with budget. The inputs are shared out between threads workers (one
+// per core if 0), and each worker loads the program into one engine of type
+// engine once and only resets it and sets its input switches afterwards.
+// Results found in cache (if not null) are not run again, the others are added
+// to it. Returns the results in the order of inputs. If a worker throws, the
+// others stop and the exception is rethrown once they have all finished.
+std::vector<SweepResult> sweep(
+    const ROM& rom, const std::vector<std::array<uint8_t, 2>>& inputs,
+    Engine::Type engine, uint64_t budget, unsigned workers = 0,
+    ResultCache* cache = nullptr, SweepMode mode = SweepMode::kScalar);
+
+// Writes results in binary form: the magic "RLSW", the number of results as a
+// 32-bit word, then 20 bytes per result: the two inputs, the status (as in
+// Emulator::Status), the flags (as in CPU::State::flags), registers A to PC
+// and the number of executed instructions as a 64-bit word. Words are big
+// endian, as in program files.
+void write_sweep(std::ostream& output, const std::vector<SweepResult>& results);
+
+// Writes results as CSV with a header line.
+void write_sweep_csv(std::ostream& output,
+                     const std::vector<SweepResult>& results);
@@ -0,0 +1,337 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "main/batch.h"
+#include "core/sweep.h"
+#include "compiler/run.h"
+
+// Program shared by the jobs that run it, loaded by the first worker that
+// needs it
+struct BatchProgram
+{
+  std::once_flag once;
+  std::array<uint16_t, ROM::kProgramDataSize> data = {};
+  uint64_t hash = 0;
+
+  // Why the program could not be loaded, empty if it was
+  std::string error;
+  bool reported = false;
+};
+
+struct BatchResult
+{
+  SweepResult run;
+  uint64_t microseconds = 0;
+};
+
+// Jobs of one worker. The worker takes them from the front and the others take
+// them from the back, so that it keeps running neighbouring jobs, which mostly
+// share its loaded program.
+struct BatchQueue
+{
+  std::mutex mutex;
+  std::deque<size_t> jobs;
+};
+
+static bool is_source(const std::string& path)
+{
+  for (const std::string extension : { ".s", ".asm", ".S" })
+  {
+    if (path.size() > extension.size() &&
+        path.compare(path.size() - extension.size(), extension.size(),
+                     extension) == 0)
+    {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void load_program(const std::string& path, BatchProgram& program)
+{
+  try
+  {
+    if (is_source(path))
+    {
+      std::vector<uint16_t> words = compile_program(path);
+
+      if (words.size() > ROM::kProgramDataSize)
+      {
+        throw std::runtime_error("program is longer than " +
+                                 std::to_string(ROM::kProgramDataSize) +
+                                 " words");
+      }
+
+      std::copy(words.begin(), words.end(), program.data.begin());
+    }
+    else
+    {
+      program.data = Emulator::ReadProgram(path);
+    }
+
+    program.hash = ROM(program.data).Hash();
+  }
+  catch (const std::runtime_error& e)
+  {
+    program.error = e.what();
+  }
+}
+
+// Takes the next job of worker, or one of another worker if it has none left.
+// Returns false when every job is taken.
+static bool take_job(std::vector<BatchQueue>& queues, size_t worker,
+                     size_t& job)
+{
+  for (size_t offset = 0; offset < queues.size(); ++offset)
+  {
+    BatchQueue& queue = queues[(worker + offset) % queues.size()];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+
+    if (!queue.jobs.empty())
+    {
+      if (offset == 0)
+      {
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+      }
+      else
+      {
+        job = queue.jobs.back();
+        queue.jobs.pop_back();
+      }
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static void write_result(std::ostream& output, std::ostream& errors,
+                         const BatchJob& job, BatchProgram& program,
+                         const BatchResult& result)
+{
+  if (!program.error.empty() && !program.reported)
+  {
+    errors << job.path << ": " << program.error << std::endl;
+    program.reported = true;
+  }
+
+  output << job.path << ',' << +job.input[0] << ',' << +job.input[1] << ',';
+
+  if (!program.error.empty())
+  {
+    output << "error,,,,,,,,,,,,,\n";
+    return;
+  }
+
+  output << status_name(result.run.status) << ',' << result.run.executed <<
+            ',' << result.microseconds;
+
+  for (uint8_t value : result.run.registers)
+  {
+    output << ',' << +value;
+  }
+
+  for (CPU::Flag flag : { CPU::Flag::kCY, CPU::Flag::kZ, CPU::Flag::kS })
+  {
+    output << ',' << (result.run.flags >> static_cast<int>(flag) & 0x1);
+  }
+
+  output << '\n';
+}
+
+std::vector<BatchJob> read_manifest(std::istream& manifest,
+                                    const std::string& name)
+{
+  std::vector<BatchJob> jobs;
+  std::string line;
+
+  for (int number = 1; std::getline(manifest, line); ++number)
+  {
+    std::istringstream fields(line);
+    BatchJob job;
+
+    if (!(fields >> job.path) || job.path[0] == '#') continue;
+
+    int value;
+    int count = 0;
+    bool valid = true;
+    while (valid && count < 2 && fields >> value)
+    {
+      valid = value >= 0 && value <= UINT8_MAX;
+      job.input[count++] = static_cast<uint8_t>(value);
+    }
+
+    if (!valid || !(fields >> std::ws).eof())
+    {
+      throw std::runtime_error("bad manifest line " + std::to_string(number) +
+                               " in \"" + name + "\"");
+    }
+
+    jobs.push_back(job);
+  }
+
+  return jobs;
+}
+
+size_t run_batch(const std::vector<BatchJob>& jobs, Engine::Type engine,
+                 uint64_t budget, unsigned workers, std::ostream& output,
+                 std::ostream& errors, ResultCache* cache)
+{
+  std::unordered_map<std::string, size_t> indices;
+  std::vector<size_t> job_programs(jobs.size());
+
+  for (size_t job = 0; job < jobs.size(); ++job)
+  {
+    job_programs[job] = indices.emplace(jobs[job].path,
+                                        indices.size()).first->second;
+  }
+
+  std::vector<BatchProgram> programs(indices.size());
+  std::vector<BatchResult> results(jobs.size());
+
+  if (workers == 0) workers = std::thread::hardware_concurrency();
+  if (workers == 0) workers = 1;
+
+  std::vector<BatchQueue> queues(workers);
+  for (size_t job = 0; job < jobs.size(); ++job)
+  {
+    queues[job * workers / jobs.size()].jobs.push_back(job);
+  }
+
+  output << "program,first,second,status,executed,microseconds,"
+            "A,B,C,D,M,S,L,PC,CY,Z,S_flag" << std::endl;
+
+  std::mutex output_mutex;
+  std::vector<bool> done(jobs.size());
+  size_t written = 0;
+
+  auto finish = [&](size_t job)
+  {
+    std::lock_guard<std::mutex> lock(output_mutex);
+    done[job] = true;
+
+    if (written < jobs.size() && done[written])
+    {
+      while (written < jobs.size() && done[written])
+      {
+        write_result(output, errors, jobs[written],
+                     programs[job_programs[written]], results[written]);
+        ++written;
+      }
+
+      output.flush();
+    }
+  };
+
+  // What each worker threw, if anything. The others stop at their next job
+  // and the first exception is rethrown here.
+  std::vector<std::exception_ptr> worker_errors(workers);
+  std::atomic<bool> stopping(false);
+
+  auto work = [&](size_t worker)
+  {
+    try
+    {
+      std::unique_ptr<Engine> machine = Engine::Create(engine);
+      size_t loaded = programs.size();
+
+      size_t job;
+      while (!stopping && take_job(queues, worker, job))
+      {
+        BatchResult& result = results[job];
+        BatchProgram& program = programs[job_programs[job]];
+
+        std::chrono::steady_clock::time_point start =
+            std::chrono::steady_clock::now();
+
+        std::call_once(program.once, load_program, std::cref(jobs[job].path),
+                       std::ref(program));
+
+        SweepResult& run = result.run;
+        run.input = jobs[job].input;
+
+        if (program.error.empty() &&
+            !(cache && cache->Find(program.hash, run.input, budget, run)))
+        {
+          if (loaded != job_programs[job])
+          {
+            machine->Load(ROM(program.data));
+            loaded = job_programs[job];
+          }
+
+          machine->Reset();
+          machine->Input(run.input[0], run.input[1]);
+
+          run.status = Emulator::Run(*machine, budget, run.executed);
+
+          const CPU::State& state = machine->GetState();
+          std::copy(state.registers, state.registers + 8, run.registers);
+          run.flags = CPU::PackFlags(state);
+
+          if (cache) cache->Insert(program.hash, budget, run);
+        }
+
+        result.microseconds = std::chrono::duration_cast<
+            std::chrono::microseconds>(std::chrono::steady_clock::now() -
+                                       start).count();
+
+        finish(job);
+      }
+    }
+    catch (...)
+    {
+      worker_errors[worker] = std::current_exception();
+      stopping = true;
+    }
+  };
+
+  std::vector<std::thread> threads;
+  try
+  {
+    for (unsigned worker = 1; worker < workers; ++worker)
+    {
+      threads.emplace_back(work, worker);
+    }
+  }
+  catch (...)
+  {
+    stopping = true;
+
+    for (std::thread& thread : threads)
+    {
+      thread.join();
+    }
+
+    throw;
+  }
+
+  work(0);
+
+  for (std::thread& thread : threads)
+  {
+    thread.join();
+  }
+
+  for (const std::exception_ptr& error : worker_errors)
+  {
+    if (error) std::rethrow_exception(error);
+  }
+
+  size_t failed = 0;
+  for (size_t job = 0; job < jobs.size(); ++job)
+  {
+    if (!programs[job_programs[job]].error.empty()) ++failed;
+  }
+
+  return failed;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "core/emulator.h"
+#include "core/resultcache.h"
+
+// One run of a batch
+struct BatchJob
+{
+  // Program file, or assembler source if it ends in .s, .asm or .S
+  std::string path;
+
+  std::array<uint8_t, 2> input = {};
+};
+
+// Reads a manifest of jobs: one job per line, the path of the program followed
+// by up to two input values. Blank lines and lines starting with '#' are
+// skipped. Name is used in error messages.
+std::vector<BatchJob> read_manifest(std::istream& manifest,
+                                    const std::string& name);
+
+// Runs jobs with engine as Emulator::Run() does with budget. Each program is
+// read (or compiled) once, and the jobs are shared out between threads workers
+// (one per core if 0) that take jobs from each other when they run out.
+//
+// A CSV line per job is written to output in the order of jobs as soon as the
+// job and every job before it are done, with its status, number of executed
+// instructions, time in microseconds and final state. Programs that can't be
+// loaded are reported to errors and their jobs get the status "error".
+// Returns the number of such jobs. Results found in cache (if not null) are
+// not run again, the others are added to it. If a worker throws, the others
+// stop and the exception is rethrown once they have all finished.
+size_t run_batch(const std::vector<BatchJob>& jobs, Engine::Type engine,
+                 uint64_t budget, unsigned workers, std::ostream& output,
+                 std::ostream& errors, ResultCache* cache = nullptr);
@@ -1,23 +1,62 @@
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <getopt.h>
 #include <unistd.h>
 
 #include "main/main.h"
+#include "main/batch.h"
+#include "main/server.h"
+#include "core/aot.h"
 #include "core/emulator.h"
+#include "core/resultcache.h"
+#include "core/specializer.h"
+#include "core/sweep.h"
 #include "compiler/run.h"
 
 int main(int argc, char* argv[])
 {
   Options options = parse_options(argc, argv);
 
-  if (options.is_asm)
+  if (!options.serve_path.empty())
+  {
+    try
+    {
+      serve(options.serve_path, options.engine, options.workers,
+            options.budget);
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << argv[0] << ": error: " << e.what() << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  else if (!options.batch_path.empty())
+  {
+    try
+    {
+      if (!execute_batch(options))
+      {
+        std::exit(EXIT_FAILURE);
+      }
+    }
+    catch (const std::runtime_error& e)
+    {
+      std::cerr << argv[0] << ": error: " << e.what() << std::endl;
+      std::exit(EXIT_FAILURE);
+    }
+  }
+  else if (options.is_asm)
   {
     try
     {
       TemporaryFile compiled = run_compiler(argv[optind]);
       compiled.Close();
 
-      Emulator emu(compiled.GetPath(), options.input);
-      options.debug ? emu.Debug() : emu.Run();
+      Emulator emu(compiled.GetPath(), options.input, false, options.engine);
+      execute(emu, options);
     }
     catch (const std::runtime_error& e)
     {
@@ -29,8 +68,8 @@ int main(int argc, char* argv[])
   {
     try
     {
-      Emulator emu(argv[optind], options.input);
-      options.debug ? emu.Debug() : emu.Run();
+      Emulator emu(argv[optind], options.input, false, options.engine);
+      execute(emu, options);
     }
     catch(const std::runtime_error& e)
     {
@@ -47,13 +86,159 @@ int main(int argc, char* argv[])
   return 0;
 }
 
+bool execute_batch(const Options& options)
+{
+  std::vector<BatchJob> jobs;
+
+  if (options.batch_path == "-")
+  {
+    jobs = read_manifest(std::cin, "standard input");
+  }
+  else
+  {
+    std::ifstream manifest(options.batch_path);
+
+    if (manifest.fail())
+    {
+      throw std::runtime_error("can't open a file \"" + options.batch_path +
+                               "\"");
+    }
+
+    jobs = read_manifest(manifest, options.batch_path);
+  }
+
+  std::unique_ptr<ResultCache> cache;
+  if (!options.cache_path.empty())
+  {
+    cache.reset(new ResultCache(options.cache_path));
+  }
+
+  return run_batch(jobs, options.engine, options.budget, options.workers,
+                   std::cout, std::cerr, cache.get()) == 0;
+}
+
+void execute(Emulator& emu, const Options& options)
+{
+  if (!options.translation_path.empty())
+  {
+    std::ofstream output(options.translation_path);
+
+    if (output.fail())
+    {
+      throw std::runtime_error("can't open a file \"" +
+                               options.translation_path + "\"");
+    }
+
+    output << translate_to_cpp(emu.GetDebugInfo().memory.program_data);
+  }
+  else if (!options.sweep_path.empty())
+  {
+    Bus::DebugInfo info = emu.GetDebugInfo();
+    std::vector<std::array<uint8_t, 2>> inputs = all_inputs();
+
+    if (!options.sweep_inputs_path.empty())
+    {
+      inputs = read_inputs(options.sweep_inputs_path);
+    }
+
+    std::unique_ptr<ResultCache> cache;
+    if (!options.cache_path.empty())
+    {
+      cache.reset(new ResultCache(options.cache_path));
+    }
+
+    std::vector<SweepResult> results = sweep(ROM(info.memory.program_data),
+                                             inputs, emu.GetEngine(),
+                                             options.budget, options.workers,
+                                             cache.get(), options.sweep_mode);
+
+    std::ofstream output(options.sweep_path, std::ios::binary);
+
+    if (output.fail())
+    {
+      throw std::runtime_error("can't open a file \"" + options.sweep_path +
+                               "\"");
+    }
+
+    write_sweep(output, results);
+
+    if (!options.sweep_csv_path.empty())
+    {
+      std::ofstream csv(options.sweep_csv_path);
+
+      if (csv.fail())
+      {
+        throw std::runtime_error("can't open a file \"" +
+                                 options.sweep_csv_path + "\"");
+      }
+
+      write_sweep_csv(csv, results);
+    }
+  }
+  else if (!options.specialization_path.empty())
+  {
+    Bus::DebugInfo info = emu.GetDebugInfo();
+    Specialization specialization;
+
+    ROM rom(info.memory.program_data, options.input);
+    if (specialize(rom, options.budget, specialization) !=
+        Emulator::Status::kHalted)
+    {
+      throw std::runtime_error("program does not halt, can't specialise it");
+    }
+
+    std::ofstream output(options.specialization_path, std::ios::binary);
+
+    if (output.fail())
+    {
+      throw std::runtime_error("can't open a file \"" +
+                               options.specialization_path + "\"");
+    }
+
+    for (uint16_t word : specialization.program)
+    {
+      output.put(word >> 8);
+      output.put(word & 0xFF);
+    }
+
+    std::cerr << "halts after " << specialization.executed <<
+                 " instructions" << std::endl;
+  }
+  else if (options.debug)
+  {
+    emu.Debug();
+  }
+  else
+  {
+    switch (emu.Run(options.budget))
+    {
+      case Emulator::Status::kLooped:
+        std::cerr << "program loops forever" << std::endl;
+        break;
+      case Emulator::Status::kBudgetExhausted:
+        std::cerr << "program did not halt within " << options.budget <<
+                     " instructions" << std::endl;
+        break;
+      default:
+        break;
+    }
+  }
+}
+
 Options parse_options(int argc, char* argv[])
 {
   Options options;
   int input_count = 0;
 
-  char option;
-  while ((option = getopt(argc, argv, "hsdi:")) != -1)
+  // --serve has no short form, 'S' only identifies it.
+  const option long_options[] = {
+    { "serve", required_argument, nullptr, 'S' },
+    { nullptr, 0, nullptr, 0 }
+  };
+
+  int option;
+  while ((option = getopt_long(argc, argv, "hsdtbje:i:n:o:p:x:c:u:l:w:m:r:",
+                               long_options, nullptr)) != -1)
   {
     switch (option)
     {
@@ -67,6 +252,100 @@ Options parse_options(int argc, char* argv[])
         options.debug = true;
         break;
       }
+      case 'e':
+      {
+        if (!parse_engine(optarg, options.engine))
+        {
+          print_help(argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      case 'n':
+      {
+        if (!parse_count(optarg, UINT64_MAX, options.budget))
+        {
+          print_help(argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      case 'o':
+      {
+        options.translation_path = optarg;
+        break;
+      }
+      case 'p':
+      {
+        options.specialization_path = optarg;
+        break;
+      }
+      case 'x':
+      {
+        options.sweep_path = optarg;
+        break;
+      }
+      case 'c':
+      {
+        options.sweep_csv_path = optarg;
+        break;
+      }
+      case 'u':
+      {
+        options.sweep_inputs_path = optarg;
+        break;
+      }
+      case 'l':
+      {
+        if (!parse_sweep_mode(optarg, options.sweep_mode))
+        {
+          print_help(argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        break;
+      }
+      // -t, -b and -j predate -e and are kept as its aliases.
+      case 't':
+      {
+        options.engine = Engine::Type::kThreaded;
+        break;
+      }
+      case 'b':
+      {
+        options.engine = Engine::Type::kBlocks;
+        break;
+      }
+      case 'j':
+      {
+        options.engine = Engine::Type::kNative;
+        break;
+      }
+      case 'w':
+      {
+        uint64_t workers;
+        if (!parse_count(optarg, UINT_MAX, workers))
+        {
+          print_help(argv[0]);
+          exit(EXIT_FAILURE);
+        }
+        options.workers = static_cast<unsigned>(workers);
+        break;
+      }
+      case 'm':
+      {
+        options.batch_path = optarg;
+        break;
+      }
+      case 'r':
+      {
+        options.cache_path = optarg;
+        break;
+      }
+      case 'S':
+      {
+        options.serve_path = optarg;
+        break;
+      }
       case 'i':
       {
         if (input_count < 2)
@@ -92,6 +371,72 @@ Options parse_options(int argc, char* argv[])
   return options;
 }
 
+std::vector<std::array<uint8_t, 2>> read_inputs(const std::string& path)
+{
+  std::ifstream file(path);
+
+  if (file.fail())
+  {
+    throw std::runtime_error("can't open a file \"" + path + "\"");
+  }
+
+  std::vector<std::array<uint8_t, 2>> inputs;
+
+  int first, second;
+  while (file >> first >> second)
+  {
+    inputs.push_back({ static_cast<uint8_t>(first),
+                       static_cast<uint8_t>(second) });
+  }
+
+  if (!file.eof())
+  {
+    throw std::runtime_error("bad input list \"" + path + "\"");
+  }
+
+  return inputs;
+}
+
+bool parse_engine(const std::string& name, Engine::Type& engine)
+{
+  if (name == "reference") engine = Engine::Type::kReference;
+  else if (name == "threaded") engine = Engine::Type::kThreaded;
+  else if (name == "blocks") engine = Engine::Type::kBlocks;
+  else if (name == "memo") engine = Engine::Type::kMemo;
+  else if (name == "native") engine = Engine::Type::kNative;
+  else if (name == "fastest") engine = Engine::Fastest();
+  else return false;
+
+  return true;
+}
+
+bool parse_count(const std::string& text, uint64_t max, uint64_t& count)
+{
+  // strtoull() would also take signs, spaces and "0x".
+  if (text.empty() ||
+      text.find_first_not_of("0123456789") != std::string::npos)
+  {
+    return false;
+  }
+
+  errno = 0;
+  unsigned long long value = std::strtoull(text.c_str(), nullptr, 10);
+  if (errno == ERANGE || value > max) return false;
+
+  count = value;
+  return true;
+}
+
+bool parse_sweep_mode(const std::string& name, SweepMode& mode)
+{
+  if (name == "scalar") mode = SweepMode::kScalar;
+  else if (name == "lanes") mode = SweepMode::kLanes;
+  else if (name == "sliced") mode = SweepMode::kSliced;
+  else return false;
+
+  return true;
+}
+
 void print_help(const std::string& binary)
 {
   std::cerr << "RelayEmulator - https://github.com/ttxine/RelayEmulator\n"
@@ -102,6 +447,33 @@ void print_help(const std::string& binary)
                "  -h                            Display this help message.\n"
                "  -s                            Compile file before execution.\n"
                "  -i <value>                    Add value to input (can be used twice).\n"
-               "  -d                            Debug mode.\n" <<
+               "  -d                            Debug mode.\n"
+               "  -o <path>                     Translate program to C++ source.\n"
+               "  -p <path>                     Write program evaluated for the input.\n"
+               "  -x <path>                     Run every input, write results to path.\n"
+               "  -c <path>                     Also write the results of -x as CSV.\n"
+               "  -u <path>                     Run -x only for the input pairs in path.\n"
+               "  -l <mode>                     How -x runs the inputs: scalar (default,\n"
+               "                                one at a time), lanes (32 at a time\n"
+               "                                in lockstep) or sliced (64 at a time,\n"
+               "                                bit-sliced).\n"
+               "  -w <count>                    Threads for -x, -m and --serve (default:\n"
+               "                                one per core).\n"
+               "  -m <path>                     Run the jobs listed in path (\"-\" for\n"
+               "                                standard input), one per line: a\n"
+               "                                program (compiled if it ends in .s,\n"
+               "                                .asm or .S) and up to two inputs.\n"
+               "  -r <path>                     Keep results of -x and -m in the cache\n"
+               "                                file at path and reuse them.\n"
+               "  --serve <path>                Serve requests on a Unix domain socket\n"
+               "                                at path (see main/server.h).\n"
+               "  -e <engine>                   Execution engine: reference (default),\n"
+               "                                threaded, blocks, memo, native (x86-64\n"
+               "                                only) or fastest.\n"
+               "  -t, -b, -j                    Deprecated: same as -e threaded,\n"
+               "                                -e blocks and -e native.\n"
+               "  -n <count>                    Stop after count instructions (for\n"
+               "                                --serve, the most any request runs;\n"
+               "                                default 2^26).\n" <<
                std::endl;
 }
@@ -1,13 +1,70 @@
 #pragma once
 #include <array>
 #include <string>
+#include <vector>
+
+#include "core/emulator.h"
+#include "core/sweep.h"
 
 struct Options
 {
   std::array<uint8_t, 2> input = {};
   bool debug = false;
   bool is_asm = false;
+  Engine::Type engine = Engine::Type::kReference;
+
+  // Maximum number of instructions to execute
+  uint64_t budget = Emulator::kNoBudget;
+
+  // If not empty, the program is translated to C++ source instead of running.
+  std::string translation_path;
+
+  // If not empty, the program specialised for the input is written there
+  // instead of running.
+  std::string specialization_path;
+
+  // If not empty, the program is run for every input (or for the inputs
+  // listed in sweep_inputs_path) and the results are written there, and to
+  // sweep_csv_path if that is not empty.
+  std::string sweep_path;
+  std::string sweep_csv_path;
+  std::string sweep_inputs_path;
+  SweepMode sweep_mode = SweepMode::kScalar;
+
+  // If not empty, the jobs listed in this manifest ("-" for the standard
+  // input) are run instead of a single program.
+  std::string batch_path;
+
+  // If not empty, sweeps and batches keep their results in the cache file at
+  // this path and take from it those already there.
+  std::string cache_path;
+
+  // If not empty, requests are served on a Unix domain socket at this path.
+  std::string serve_path;
+
+  // Sweep, batch and server threads, 0 for one per core
+  unsigned workers = 0;
 };
 
+// Runs the jobs of the batch manifest, returns false if any of them failed.
+bool execute_batch(const Options& options);
+
+// Runs, debugs or translates the loaded program.
+void execute(Emulator& emu, const Options& options);
+
 Options parse_options(int argc, char* argv[]);
+
+// Reads pairs of input values separated by whitespace from the file at path.
+std::vector<std::array<uint8_t, 2>> read_inputs(const std::string& path);
+
+// Sets engine to the engine called name. Returns false if there is none.
+bool parse_engine(const std::string& name, Engine::Type& engine);
+
+// Sets count to the decimal number in text. Returns false if text is not one
+// or the number is greater than max.
+bool parse_count(const std::string& text, uint64_t max, uint64_t& count);
+
+// Sets mode to the sweep mode called name. Returns false if there is none.
+bool parse_sweep_mode(const std::string& name, SweepMode& mode);
+
 void print_help(const std::string& binary);
@@ -0,0 +1,569 @@
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "main/server.h"
+#include "core/emulator.h"
+#include "compiler/run.h"
+
+// Longest request accepted. Programs are 256 bytes, sources rarely more than a
+// few kilobytes.
+static const uint32_t kMaxRequestSize = 1 << 20;
+
+// Most compiled sources kept, and most programs kept loaded per worker
+static const size_t kMaxCompiled = 1024;
+static const size_t kMaxLoaded = 64;
+
+// Longest wait for a client to take a reply. A client that takes longer holds
+// a worker until then and is dropped.
+static const int kReplyTimeoutSeconds = 5;
+
+typedef std::array<uint16_t, ROM::kProgramDataSize> ProgramData;
+
+// Engine of a worker with a program loaded
+struct LoadedProgram
+{
+  ProgramData program;
+  std::unique_ptr<Engine> engine;
+};
+
+typedef std::unordered_map<uint64_t, LoadedProgram> LoadedPrograms;
+
+// What a connection has loaded, set and run
+struct Session
+{
+  ProgramData program = {};
+  uint64_t hash = 0;
+  bool loaded = false;
+
+  std::array<uint8_t, 2> input = {};
+
+  Emulator::Status status = Emulator::Status::kHalted;
+  CPU::State state = {};
+  uint64_t executed = 0;
+  bool run = false;
+};
+
+struct Connection
+{
+  int fd;
+  Session session;
+
+  // What has arrived of the next requests
+  std::string input;
+};
+
+// State shared by the workers and the thread polling the connections. Idle
+// connections are polled until a whole request has arrived, then queued for
+// the next free worker, which serves that request and hands the connection
+// back.
+struct Server
+{
+  Engine::Type engine;
+
+  // Most instructions a run may execute
+  uint64_t budget;
+
+  std::mutex connections_mutex;
+  std::condition_variable request_arrived;
+  std::queue<std::unique_ptr<Connection>> requests;
+
+  // Connections served, to poll again. Writing to wake_fd interrupts poll().
+  std::vector<std::unique_ptr<Connection>> served;
+  int wake_fd;
+
+  std::mutex compiled_mutex;
+  std::unordered_map<std::string, ProgramData> compiled;
+};
+
+// Sends data on fd, with the flags of send() in flags. Returns false if it
+// can't be sent whole.
+static bool write_bytes(int fd, const void* data, size_t size, int flags = 0)
+{
+  const uint8_t* bytes = static_cast<const uint8_t*>(data);
+
+  while (size > 0)
+  {
+    ssize_t count = send(fd, bytes, size, MSG_NOSIGNAL | flags);
+
+    if (count < 0 && errno == EINTR) continue;
+    if (count <= 0) return false;
+
+    bytes += count;
+    size -= count;
+  }
+
+  return true;
+}
+
+static void put_word(std::string& data, uint64_t word, int bytes)
+{
+  for (int byte = bytes - 1; byte >= 0; --byte)
+  {
+    data.push_back(static_cast<char>(word >> (byte * 8)));
+  }
+}
+
+static uint64_t get_word(const std::string& data, size_t offset, int bytes)
+{
+  uint64_t word = 0;
+
+  for (int byte = 0; byte < bytes; ++byte)
+  {
+    word = word << 8 | static_cast<uint8_t>(data[offset + byte]);
+  }
+
+  return word;
+}
+
+static bool reply(int fd, bool success, const std::string& data,
+                  int flags = 0)
+{
+  std::string message;
+
+  put_word(message, data.size() + 1, 4);
+  message.push_back(success ? 0 : 1);
+  message += data;
+
+  return write_bytes(fd, message.data(), message.size(), flags);
+}
+
+static ProgramData compile(Server& server, const std::string& source)
+{
+  {
+    std::lock_guard<std::mutex> lock(server.compiled_mutex);
+    auto compiled = server.compiled.find(source);
+
+    if (compiled != server.compiled.end()) return compiled->second;
+  }
+
+  std::vector<uint16_t> words = compile_source(source);
+  ProgramData program = {};
+
+  if (words.size() > ROM::kProgramDataSize)
+  {
+    throw std::runtime_error("program is longer than " +
+                             std::to_string(ROM::kProgramDataSize) +
+                             " words");
+  }
+
+  std::copy(words.begin(), words.end(), program.begin());
+
+  std::lock_guard<std::mutex> lock(server.compiled_mutex);
+  if (server.compiled.size() < kMaxCompiled)
+  {
+    server.compiled.emplace(source, program);
+  }
+
+  return program;
+}
+
+static std::string encode_state(const Session& session)
+{
+  std::string data;
+
+  data.push_back(static_cast<char>(session.status));
+  data.push_back(CPU::PackFlags(session.state));
+  data.append(reinterpret_cast<const char*>(session.state.registers),
+              sizeof(session.state.registers));
+  put_word(data, session.executed, 8);
+
+  return data;
+}
+
+// Carries out request on session, returns the data of the reply. Throws
+// std::runtime_error if the request can't be carried out.
+static std::string handle(Server& server, LoadedPrograms& loaded,
+                          Session& session, ServerRequest request,
+                          const std::string& data)
+{
+  switch (request)
+  {
+    case ServerRequest::kAssemble:
+    case ServerRequest::kLoad:
+    {
+      if (request == ServerRequest::kAssemble)
+      {
+        session.program = compile(server, data);
+      }
+      else
+      {
+        if (data.size() > ROM::kProgramDataSize * 2)
+        {
+          throw std::runtime_error("program is longer than " +
+                                   std::to_string(ROM::kProgramDataSize) +
+                                   " words");
+        }
+
+        session.program = {};
+        for (size_t addr = 0; addr * 2 + 1 < data.size(); ++addr)
+        {
+          session.program[addr] = get_word(data, addr * 2, 2);
+        }
+      }
+
+      session.hash = ROM(session.program).Hash();
+      session.loaded = true;
+      session.run = false;
+
+      std::string hash;
+      put_word(hash, session.hash, 8);
+      return hash;
+    }
+    case ServerRequest::kInput:
+    {
+      if (data.size() != 2) throw std::runtime_error("bad input");
+
+      session.input = { static_cast<uint8_t>(data[0]),
+                        static_cast<uint8_t>(data[1]) };
+      return std::string();
+    }
+    case ServerRequest::kRun:
+    {
+      if (!session.loaded) throw std::runtime_error("no program loaded");
+      if (!data.empty() && data.size() != 8)
+      {
+        throw std::runtime_error("bad budget");
+      }
+
+      uint64_t budget = data.empty() ? server.budget :
+                                       std::min(get_word(data, 0, 8),
+                                                server.budget);
+
+      if (loaded.size() >= kMaxLoaded && !loaded.count(session.hash))
+      {
+        loaded.clear();
+      }
+
+      // A program with the same hash as another replaces it.
+      LoadedProgram& program = loaded[session.hash];
+      if (!program.engine || program.program != session.program)
+      {
+        program.program = session.program;
+        program.engine = Engine::Create(server.engine);
+        program.engine->Load(ROM(program.program));
+      }
+
+      Engine& machine = *program.engine;
+      machine.Reset();
+      machine.Input(session.input[0], session.input[1]);
+
+      session.status = Emulator::Run(machine, budget, session.executed);
+      session.state = machine.GetState();
+      session.run = true;
+
+      return encode_state(session);
+    }
+    case ServerRequest::kState:
+    {
+      if (!session.run) throw std::runtime_error("nothing has been run");
+
+      return encode_state(session);
+    }
+    default:
+    {
+      throw std::runtime_error("unknown request");
+    }
+  }
+}
+
+// Returns the length of the request at the front of input with its header, 0
+// if the header has not fully arrived.
+static size_t request_length(const std::string& input)
+{
+  return input.size() < 4 ? 0 : 4 + get_word(input, 0, 4);
+}
+
+// Carries out the request at the front of the input of connection, which has
+// fully arrived, and replies. Returns false if the reply can't be sent.
+static bool serve_request(Server& server, LoadedPrograms& loaded,
+                          Connection& connection)
+{
+  size_t length = request_length(connection.input);
+
+  ServerRequest request = static_cast<ServerRequest>(connection.input[4]);
+  std::string data = connection.input.substr(5, length - 5);
+  connection.input.erase(0, length);
+
+  std::string result;
+  try
+  {
+    result = handle(server, loaded, connection.session, request, data);
+  }
+  catch (const std::exception& e)
+  {
+    return reply(connection.fd, false, e.what());
+  }
+  catch (...)
+  {
+    return reply(connection.fd, false, "internal error");
+  }
+
+  return reply(connection.fd, true, result);
+}
+
+// Reads what has arrived on connection without waiting. Returns false if it
+// was closed or broken.
+static bool receive(Connection& connection)
+{
+  char bytes[1 << 16];
+
+  for (;;)
+  {
+    ssize_t count = recv(connection.fd, bytes, sizeof(bytes), MSG_DONTWAIT);
+
+    if (count > 0)
+    {
+      connection.input.append(bytes, count);
+      return true;
+    }
+
+    if (count < 0 && errno == EINTR) continue;
+
+    return count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+  }
+}
+
+// Queues connection for the workers if a whole request has arrived on it, or
+// keeps it in idle to be polled. Replies with a failure and closes it if the
+// length of the request is bad, as the rest of its input can't be parsed.
+static void dispatch(Server& server,
+                     std::vector<std::unique_ptr<Connection>>& idle,
+                     std::unique_ptr<Connection> connection)
+{
+  size_t length = request_length(connection->input);
+
+  if (length == 4 || length > 4 + kMaxRequestSize)
+  {
+    // The polling thread must not wait for a client that doesn't read.
+    reply(connection->fd, false, "bad request length", MSG_DONTWAIT);
+    close(connection->fd);
+  }
+  else if (length != 0 && connection->input.size() >= length)
+  {
+    std::lock_guard<std::mutex> lock(server.connections_mutex);
+    server.requests.push(std::move(connection));
+    server.request_arrived.notify_one();
+  }
+  else
+  {
+    idle.push_back(std::move(connection));
+  }
+}
+
+// Polls listener and the idle connections, queueing those with a whole
+// request for the workers and taking back those they served. Only returns by
+// throwing.
+static void poll_connections(Server& server, int listener, int wake_fd)
+{
+  std::vector<std::unique_ptr<Connection>> idle;
+  std::vector<pollfd> fds;
+
+  for (;;)
+  {
+    fds.assign(2, pollfd());
+    fds[0].fd = listener;
+    fds[0].events = POLLIN;
+    fds[1].fd = wake_fd;
+    fds[1].events = POLLIN;
+
+    for (const std::unique_ptr<Connection>& connection : idle)
+    {
+      pollfd fd = {};
+      fd.fd = connection->fd;
+      fd.events = POLLIN;
+      fds.push_back(fd);
+    }
+
+    if (poll(fds.data(), fds.size(), -1) == -1)
+    {
+      if (errno == EINTR) continue;
+
+      throw std::runtime_error("server: can't poll connections: " +
+                               std::string(strerror(errno)));
+    }
+
+    std::vector<std::unique_ptr<Connection>> polled;
+    polled.swap(idle);
+
+    for (size_t index = 0; index < polled.size(); ++index)
+    {
+      if (!fds[index + 2].revents)
+      {
+        idle.push_back(std::move(polled[index]));
+      }
+      else if (receive(*polled[index]))
+      {
+        dispatch(server, idle, std::move(polled[index]));
+      }
+      else
+      {
+        close(polled[index]->fd);
+      }
+    }
+
+    if (fds[1].revents)
+    {
+      char bytes[64];
+      while (read(wake_fd, bytes, sizeof(bytes)) == sizeof(bytes))
+      {
+      }
+
+      std::vector<std::unique_ptr<Connection>> served;
+      {
+        std::lock_guard<std::mutex> lock(server.connections_mutex);
+        served.swap(server.served);
+      }
+
+      // A connection may have sent its next request already.
+      for (std::unique_ptr<Connection>& connection : served)
+      {
+        dispatch(server, idle, std::move(connection));
+      }
+    }
+
+    if (fds[0].revents)
+    {
+      int fd = accept(listener, nullptr, nullptr);
+
+      if (fd == -1)
+      {
+        if (errno == EINTR || errno == ECONNABORTED || errno == EAGAIN)
+        {
+          continue;
+        }
+
+        throw std::runtime_error("server: can't accept a connection: " +
+                                 std::string(strerror(errno)));
+      }
+
+      timeval timeout = {};
+      timeout.tv_sec = kReplyTimeoutSeconds;
+      setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+      idle.push_back(std::unique_ptr<Connection>(new Connection()));
+      idle.back()->fd = fd;
+    }
+  }
+}
+
+void serve(const std::string& path, Engine::Type engine, unsigned workers,
+           uint64_t budget)
+{
+  sockaddr_un address = {};
+  address.sun_family = AF_UNIX;
+
+  if (path.size() >= sizeof(address.sun_path))
+  {
+    throw std::runtime_error("server: socket path is too long \"" + path +
+                             "\"");
+  }
+
+  std::strcpy(address.sun_path, path.c_str());
+
+  int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener == -1)
+  {
+    throw std::runtime_error("server: can't create a socket: " +
+                             std::string(strerror(errno)));
+  }
+
+  unlink(path.c_str());
+  if (bind(listener, reinterpret_cast<sockaddr*>(&address),
+           sizeof(address)) == -1 || listen(listener, SOMAXCONN) == -1)
+  {
+    std::string error = strerror(errno);
+    close(listener);
+
+    throw std::runtime_error("server: can't listen on \"" + path + "\": " +
+                             error);
+  }
+
+  int wake[2];
+  if (pipe(wake) == -1)
+  {
+    std::string error = strerror(errno);
+    close(listener);
+
+    throw std::runtime_error("server: can't create a pipe: " + error);
+  }
+
+  // The polling thread drains the pipe whole, and a full pipe wakes it
+  // anyway.
+  fcntl(wake[0], F_SETFL, O_NONBLOCK);
+  fcntl(wake[1], F_SETFL, O_NONBLOCK);
+
+  // Shared with the workers, which outlive this function if it throws
+  std::shared_ptr<Server> server = std::make_shared<Server>();
+  server->engine = engine;
+  server->budget = budget == Emulator::kNoBudget ? kDefaultBudget : budget;
+  server->wake_fd = wake[1];
+
+  if (workers == 0) workers = std::thread::hardware_concurrency();
+  if (workers == 0) workers = 1;
+
+  auto work = [server]()
+  {
+    LoadedPrograms loaded;
+
+    for (;;)
+    {
+      std::unique_ptr<Connection> connection;
+      {
+        std::unique_lock<std::mutex> lock(server->connections_mutex);
+        server->request_arrived.wait(lock, [&]()
+        {
+          return !server->requests.empty();
+        });
+
+        connection = std::move(server->requests.front());
+        server->requests.pop();
+      }
+
+      if (!serve_request(*server, loaded, *connection))
+      {
+        close(connection->fd);
+        continue;
+      }
+
+      {
+        std::lock_guard<std::mutex> lock(server->connections_mutex);
+        server->served.push_back(std::move(connection));
+      }
+
+      char byte = 0;
+      while (write(server->wake_fd, &byte, 1) == -1 && errno == EINTR)
+      {
+      }
+    }
+  };
+
+  for (unsigned worker = 0; worker < workers; ++worker)
+  {
+    std::thread(work).detach();
+  }
+
+  try
+  {
+    poll_connections(*server, listener, wake[0]);
+  }
+  catch (...)
+  {
+    close(listener);
+    throw;
+  }
+}
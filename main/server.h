@@ -0,0 +1,40 @@
+#pragma once
+#include <string>
+
+#include "core/engine.h"
+
+// Requests of the server. Each request is a 32-bit length, the code and the
+// data; each reply is a 32-bit length, 0 (success) or 1 (failure, the data is
+// the message) and the data. Words are big endian, as in program files.
+enum class ServerRequest : uint8_t
+{
+  // Data is assembler source. Compiles and loads it, replies with the hash of
+  // the program (as in ROM::Hash()).
+  kAssemble = 1,
+  // Data is a program file. Loads it, replies with the hash of the program.
+  kLoad,
+  // Data is the values of the two input switches.
+  kInput,
+  // Data is the budget, no data for the most the server allows (a larger
+  // budget is cut to it). Runs the loaded program from reset as
+  // Emulator::Run() does, replies as kState.
+  kRun,
+  // Replies with the result of the last run: the status (as in
+  // Emulator::Status), the flags (as in CPU::State::flags), registers A to PC
+  // and the number of executed instructions.
+  kState
+};
+
+// Most instructions run per request by default
+const uint64_t kDefaultBudget = 1ull << 26;
+
+// Serves requests on the Unix domain socket at path until the process is
+// killed. Each connection has its own loaded program, input and result. Idle
+// connections are polled, and each request is served by the next free of
+// workers threads (one per core if 0), so idle clients hold none of them.
+// Compiled sources are kept, and programs stay loaded in the engines of the
+// workers keyed by their hash, so sending a program again costs only its
+// transfer. No run executes more than budget instructions (kDefaultBudget if
+// Emulator::kNoBudget), so no client can hold a worker for long.
+void serve(const std::string& path, Engine::Type engine, unsigned workers,
+           uint64_t budget);
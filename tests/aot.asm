@@ -0,0 +1,40 @@
+load a, 0x80
+load b, 0x81
+movi c, 0
+sub l, pc, 7
+sbc l, l, pc
+movi d, 0x10
+movi m, 0x80
+load s, m
+call subr
+loop:
+or f, b, b
+jmp z, done
+add c, c, a
+sub b, b, 1
+jmp loop
+done:
+xor a, a, c
+not b, a
+ror c, b
+shr d, c
+rcr a, d
+adc b, a, 7
+sbc c, b, d
+and f, c, 3
+movi nz, a, 0x55
+movi z, b, 0x66
+ror d, pc
+not s, pc
+sub m, pc, 7
+add l, l, pc
+adc b, pc, 7
+xor a, a, d
+add a, a, s
+add a, a, m
+add a, a, l
+halt
+subr:
+add d, d, 5
+sub d, d, 7
+mov pc, l
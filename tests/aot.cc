@@ -0,0 +1,82 @@
+// Runs the translation of tests/aot.asm, compiled into this test by the build,
+// and compares it with the reference engine for a spread of inputs and
+// budgets. The program takes PC as an ALU operand, which makes the translation
+// compute constant results out of the range of uint8_t.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/aot.h"
+#include "core/engine.h"
+#include "compiler/run.h"
+
+extern "C" uint64_t relay_run(RelayState* state);
+
+static const uint64_t kBudgets[] = { UINT64_MAX, 30, 3 };
+
+int main(int argc, char* argv[])
+{
+  if (argc != 2)
+  {
+    std::fprintf(stderr, "usage: %s <path to tests/aot.asm>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  std::vector<uint16_t> words = compile_program(argv[1]);
+  std::array<uint16_t, ROM::kProgramDataSize> data = {};
+  std::copy(words.begin(), words.end(), data.begin());
+
+  std::unique_ptr<Engine> machine = Engine::Create(Engine::Type::kReference);
+  machine->Load(ROM(data));
+
+  bool passed = true;
+
+  for (int index = 0; index < (1 << 16); index += 251)
+  {
+    uint8_t first = index >> 8;
+    uint8_t second = index;
+
+    for (uint64_t budget : kBudgets)
+    {
+      machine->Reset();
+      machine->Input(first, second);
+
+      CPU::State start = machine->GetState();
+      uint8_t flags = CPU::PackFlags(start);
+
+      RelayState state = {};
+      memcpy(state.registers, start.registers, sizeof(state.registers));
+      state.sign = flags >> static_cast<int>(CPU::Flag::kS) & 0x1;
+      state.zero = flags >> static_cast<int>(CPU::Flag::kZ) & 0x1;
+      state.carry = flags >> static_cast<int>(CPU::Flag::kCY) & 0x1;
+      state.instruction = start.instruction;
+      state.budget = budget;
+      state.input[0] = first;
+      state.input[1] = second;
+
+      uint64_t translated = relay_run(&state);
+      uint64_t executed = machine->Run(budget);
+
+      CPU::State end = machine->GetState();
+      flags = CPU::PackFlags(end);
+
+      if (translated != executed || state.halted != machine->Stopped() ||
+          memcmp(state.registers, end.registers,
+                 sizeof(end.registers)) != 0 ||
+          state.sign != (flags >> static_cast<int>(CPU::Flag::kS) & 0x1) ||
+          state.zero != (flags >> static_cast<int>(CPU::Flag::kZ) & 0x1) ||
+          state.carry != (flags >> static_cast<int>(CPU::Flag::kCY) & 0x1))
+      {
+        std::fprintf(stderr, "input %d %d, budget %llu: translation differs "
+                     "after %llu instructions, expected %llu\n", first,
+                     second, static_cast<unsigned long long>(budget),
+                     static_cast<unsigned long long>(translated),
+                     static_cast<unsigned long long>(executed));
+        passed = false;
+      }
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,90 @@
+// Runs a program with a breakpoint in its loop on the debugging bus, resuming
+// at every stop, and compares the stops and the final state with a run
+// without breakpoints.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/bus.h"
+#include "tests/support.h"
+
+// Address of "add c, c, a" in kMultiplySource, executed once per iteration
+static const uint8_t kBreakpoint = 5;
+
+static const uint8_t kIterations = 4;
+
+typedef BasicBus<DebugHooks> DebugBus;
+
+// Runs bus to its HALT, one instruction at a time if cycles, resuming at
+// every breakpoint. Returns the number of stops at a breakpoint, giving up
+// after one more than expected.
+static int run(DebugBus& bus, bool cycles)
+{
+  int stops = 0;
+
+  while (stops <= kIterations)
+  {
+    if (cycles)
+    {
+      while (!bus.Stopped()) bus.Cycle();
+    }
+    else
+    {
+      while (!bus.Stopped()) bus.Run(UINT64_MAX);
+    }
+
+    if (bus.GetState().registers[CPU::kPC] != kBreakpoint) return stops;
+
+    ++stops;
+    bus.Resume();
+  }
+
+  return stops;
+}
+
+int main()
+{
+  ProgramData data = assemble(kMultiplySource);
+
+  DebugBus expected;
+  expected.ConnectROM(ROM(data, { 3, kIterations }));
+  run(expected, false);
+
+  bool passed = true;
+
+  for (bool cycles : { false, true })
+  {
+    DebugBus bus;
+    bus.ConnectROM(ROM(data, { 3, kIterations }));
+    bus.GetHooks().SetBreakpoint(kBreakpoint);
+
+    int stops = run(bus, cycles);
+    const char* name = cycles ? "cycles" : "run";
+
+    if (stops != kIterations)
+    {
+      std::fprintf(stderr, "%s: %d stops at the breakpoint, expected %d\n",
+                   name, stops, kIterations);
+      passed = false;
+    }
+
+    if (bus.GetHooks().GetExecutionCount(kBreakpoint) != kIterations)
+    {
+      std::fprintf(stderr, "%s: breakpoint executed %llu times, expected %d\n",
+                   name, static_cast<unsigned long long>(
+                       bus.GetHooks().GetExecutionCount(kBreakpoint)),
+                   kIterations);
+      passed = false;
+    }
+
+    if (memcmp(bus.GetState().registers, expected.GetState().registers,
+               sizeof(expected.GetState().registers)) != 0)
+    {
+      std::fprintf(stderr, "%s: final registers differ\n", name);
+      passed = false;
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
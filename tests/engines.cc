@@ -0,0 +1,261 @@
+// Compares every engine with the reference engine on programs made of
+// counting loops of several shapes (see core/loops.h), which the block,
+// memo and native engines skip to their exit. Each engine is reused for
+// every input and budget, so memoised summaries and exit tables carry over
+// from one run to the next, and budgets are also spent in short slices that
+// end inside the loops. Other programs are patched between runs, and must
+// then run as if loaded patched.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "core/engine.h"
+#include "tests/support.h"
+
+struct Program
+{
+  const char* name;
+  const char* source;
+};
+
+static const Program kPrograms[] = {
+  // Counts down to zero, with accumulators of every kind and a NOP
+  { "down",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "movi c, 0\n"
+    "loop:\n"
+    "add c, c, a\n"
+    "xor d, d, a\n"
+    "sub l, l, 3\n"
+    "nop\n"
+    "sub b, b, 1\n"
+    "jmp nz, loop\n"
+    "halt\n" },
+  // Counts up until the carry, then a second loop until the sign
+  { "up",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "loop:\n"
+    "add c, c, 1\n"
+    "add b, b, 3\n"
+    "jmp nc, loop\n"
+    "second:\n"
+    "sub d, d, b\n"
+    "xor s, s, 5\n"
+    "add a, a, 5\n"
+    "jmp ns, second\n"
+    "halt\n" },
+  // Halves the counter until it is zero
+  { "shift",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "loop:\n"
+    "add c, c, b\n"
+    "shr a, a\n"
+    "jmp nz, loop\n"
+    "halt\n" },
+  // Rotates through the carry, which starts from the inputs
+  { "carry",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "add f, a, b\n"
+    "loop:\n"
+    "rcr b, b\n"
+    "jmp nc, loop\n"
+    "halt\n" },
+  // Only sets flags, so spins forever when the first input is a multiple of 8
+  { "flags",
+    "load a, 0x80\n"
+    "loop:\n"
+    "add c, c, 1\n"
+    "and f, a, 7\n"
+    "jmp z, loop\n"
+    "halt\n" },
+  // Not a counting loop: the accumulator reads a register the loop writes
+  { "other",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "loop:\n"
+    "add c, c, b\n"
+    "add d, d, c\n"
+    "sub b, b, 1\n"
+    "jmp nz, loop\n"
+    "halt\n" }
+};
+
+struct PatchedProgram
+{
+  const char* name;
+  const char* source;
+
+  // Same as source with some words changed
+  const char* patched;
+};
+
+static const PatchedProgram kPatchedPrograms[] = {
+  // The loop reads the low byte of the word at 0x0A, which memoised
+  // summaries depend on though it is not a register.
+  { "memory",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "movi m, 0x0A\n"
+    "loop:\n"
+    "load c, m\n"
+    "add d, d, c\n"
+    "add d, d, a\n"
+    "sub b, b, 1\n"
+    "jmp nz, loop\n"
+    "halt\n"
+    "nop\n"
+    "movi d, 0x11\n",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "movi m, 0x0A\n"
+    "loop:\n"
+    "load c, m\n"
+    "add d, d, c\n"
+    "add d, d, a\n"
+    "sub b, b, 1\n"
+    "jmp nz, loop\n"
+    "halt\n"
+    "nop\n"
+    "movi d, 0x5A\n" },
+  // Changes the step of a counting loop, and so its exit table
+  { "step",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "loop:\n"
+    "add c, c, a\n"
+    "sub b, b, 1\n"
+    "jmp nz, loop\n"
+    "halt\n",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "loop:\n"
+    "add c, c, a\n"
+    "sub b, b, 3\n"
+    "jmp nz, loop\n"
+    "halt\n" }
+};
+
+static const uint64_t kBudgets[] = { 100000, 1000, 37, 5 };
+
+// Budget of the slices runs are also split into
+static const uint64_t kSlice = 13;
+
+// Runs machine from reset for input until it stops or executes budget
+// instructions, in slices of slice instructions. Returns the number of
+// executed instructions.
+static uint64_t run(Engine& machine, uint8_t first, uint8_t second,
+                    uint64_t budget, uint64_t slice)
+{
+  machine.Reset();
+  machine.Input(first, second);
+
+  uint64_t executed = 0;
+
+  while (executed < budget && !machine.Stopped())
+  {
+    executed += machine.Run(std::min(slice, budget - executed));
+  }
+
+  return executed;
+}
+
+// Compares machine, which runs type, with reference, both loaded with the
+// same program, for a spread of inputs, budgets and slices. Returns false if
+// they differ.
+static bool compare(const char* name, Engine& machine, Engine::Type type,
+                    Engine& reference)
+{
+  bool passed = true;
+
+  for (int index = 0; index < (1 << 16); index += 509)
+  {
+    uint8_t first = index >> 8;
+    uint8_t second = index;
+
+    for (uint64_t budget : kBudgets)
+    {
+      uint64_t expected = run(reference, first, second, budget, budget);
+
+      for (uint64_t slice : { budget, kSlice })
+      {
+        uint64_t executed = run(machine, first, second, budget, slice);
+
+        if (executed != expected || machine.Stopped() != reference.Stopped() ||
+            !same_state(machine.GetState(), reference.GetState()))
+        {
+          std::fprintf(stderr, "%s: engine %d, input %d %d, budget %llu in "
+                       "slices of %llu: %llu instructions, expected %llu\n",
+                       name, static_cast<int>(type), first, second,
+                       static_cast<unsigned long long>(budget),
+                       static_cast<unsigned long long>(slice),
+                       static_cast<unsigned long long>(executed),
+                       static_cast<unsigned long long>(expected));
+          passed = false;
+        }
+      }
+    }
+  }
+
+  return passed;
+}
+
+int main()
+{
+  bool passed = true;
+
+  for (const Program& program : kPrograms)
+  {
+    ROM rom(assemble(program.source));
+
+    std::unique_ptr<Engine> reference =
+        Engine::Create(Engine::Type::kReference);
+    reference->Load(rom);
+
+    for (Engine::Type type : kEngines)
+    {
+      std::unique_ptr<Engine> machine = Engine::Create(type);
+      machine->Load(rom);
+
+      passed &= compare(program.name, *machine, type, *reference);
+    }
+  }
+
+  // Patches the words that differ into machines that ran the original, and
+  // compares them with machines loaded with the patched program.
+  for (const PatchedProgram& program : kPatchedPrograms)
+  {
+    ProgramData original = assemble(program.source);
+    ProgramData patched = assemble(program.patched);
+
+    std::unique_ptr<Engine> reference =
+        Engine::Create(Engine::Type::kReference);
+    std::unique_ptr<Engine> patched_reference =
+        Engine::Create(Engine::Type::kReference);
+    reference->Load(ROM(original));
+    patched_reference->Load(ROM(patched));
+
+    for (Engine::Type type : kEngines)
+    {
+      std::unique_ptr<Engine> machine = Engine::Create(type);
+      machine->Load(ROM(original));
+
+      passed &= compare(program.name, *machine, type, *reference);
+
+      for (int addr = 0; addr < ROM::kProgramDataSize; ++addr)
+      {
+        if (original[addr] != patched[addr])
+        {
+          machine->Patch(addr, patched[addr]);
+        }
+      }
+
+      passed &= compare(program.name, *machine, type, *patched_reference);
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
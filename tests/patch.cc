@@ -0,0 +1,93 @@
+// Pauses kMultiplySource in its loop, after its blocks have been translated
+// and linked to each other, patches a word of the loop and finishes the run.
+// Compares the result, on every engine, with a freshly loaded reference
+// engine given the patched program and the state at the pause. Each patch is
+// then undone, so later runs must also see the original word again.
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "core/engine.h"
+#include "tests/support.h"
+
+struct PatchedWord
+{
+  uint8_t addr;
+  const char* instruction;
+};
+
+// Words of the loop of kMultiplySource: the test of the counter, the
+// accumulation and the decrement
+static const PatchedWord kPatches[] = {
+  { 3, "and f, b, 7" },
+  { 5, "xor c, c, a" },
+  { 6, "sub b, b, 2" }
+};
+
+static const uint8_t kInputs[][2] = { { 3, 7 }, { 200, 45 }, { 1, 255 } };
+
+// Instructions run before the patch, some of them a few laps into the loop
+static const uint64_t kPauses[] = { 4, 5, 6, 7, 8, 20, 21, 22, 23, 24, 51 };
+
+// Runs are stopped here if the patch makes the program loop forever.
+static const uint64_t kBudget = 10000;
+
+int main()
+{
+  ProgramData original = assemble(kMultiplySource);
+  bool passed = true;
+
+  for (Engine::Type type : kEngines)
+  {
+    std::unique_ptr<Engine> machine = Engine::Create(type);
+    machine->Load(ROM(original));
+
+    for (const PatchedWord& patch : kPatches)
+    {
+      ProgramData patched = original;
+      std::string line = std::string(patch.instruction) + "\n";
+      patched[patch.addr] = assemble(line.c_str())[0];
+
+      for (const uint8_t* input : kInputs)
+      {
+        for (uint64_t pause : kPauses)
+        {
+          machine->Reset();
+          machine->Input(input[0], input[1]);
+
+          // Short runs may halt before the pause.
+          uint64_t paused = machine->Run(pause);
+          MachineSnapshot snapshot = machine->Snapshot();
+
+          machine->Patch(patch.addr, patched[patch.addr]);
+          uint64_t executed = paused + machine->Run(kBudget - paused);
+          machine->Patch(patch.addr, original[patch.addr]);
+
+          std::unique_ptr<Engine> reference =
+              Engine::Create(Engine::Type::kReference);
+          reference->Load(ROM(patched));
+          reference->Restore(snapshot);
+
+          uint64_t expected = paused + reference->Run(kBudget - paused);
+
+          if (executed != expected ||
+              machine->Stopped() != reference->Stopped() ||
+              !same_state(machine->GetState(), reference->GetState()))
+          {
+            std::fprintf(stderr, "engine %d, \"%s\" at 0x%02X, input %d %d, "
+                         "pause after %llu: %llu instructions, expected "
+                         "%llu\n", static_cast<int>(type), patch.instruction,
+                         patch.addr, input[0], input[1],
+                         static_cast<unsigned long long>(pause),
+                         static_cast<unsigned long long>(executed),
+                         static_cast<unsigned long long>(expected));
+            passed = false;
+          }
+        }
+      }
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
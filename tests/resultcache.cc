@@ -0,0 +1,249 @@
+// Inserts results into a ResultCache, finds them again after reopening the
+// file, and checks that results pushed out of their probe window are
+// replaced, that slots which fail their checksum read as missing, and that a
+// file with a wrong header or size is emptied.
+
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "core/resultcache.h"
+#include "tests/support.h"
+
+// Small enough for probe windows to fill up
+static const uint64_t kSlots = 16;
+
+// Results inserted by most checks, few enough to all fit
+static const int kCount = 4;
+
+static const uint64_t kProgram = 0x0123456789ABCDEF;
+static const uint64_t kBudget = 1000;
+
+// Size of the header of the file: "RLRC", the version and the slot count
+static const off_t kHeaderSize = 16;
+
+static SweepResult make_result(int index)
+{
+  SweepResult result;
+  result.input = { static_cast<uint8_t>(index >> 8),
+                   static_cast<uint8_t>(index) };
+  result.status = Emulator::Status::kHalted;
+  result.registers[CPU::kC] = static_cast<uint8_t>(index * 7);
+  result.flags = index & 0x7;
+  result.executed = index * 3 + 1;
+
+  return result;
+}
+
+// Returns the number of results 0 to count - 1 found in cache, reporting
+// those found with other values.
+static int count_found(ResultCache& cache, int count, bool& passed)
+{
+  int found = 0;
+
+  for (int index = 0; index < count; ++index)
+  {
+    SweepResult expected = make_result(index);
+    SweepResult result;
+
+    if (!cache.Find(kProgram, expected.input, kBudget, result)) continue;
+
+    if (!same_result(result, expected))
+    {
+      std::fprintf(stderr, "result %d differs\n", index);
+      passed = false;
+    }
+
+    ++found;
+  }
+
+  return found;
+}
+
+static off_t file_size(const std::string& path)
+{
+  struct stat status;
+  return stat(path.c_str(), &status) == 0 ? status.st_size : -1;
+}
+
+// Overwrites size bytes of the file at path from offset with value.
+static void overwrite(const std::string& path, off_t offset, size_t size,
+                      uint8_t value)
+{
+  std::string bytes(size, static_cast<char>(value));
+
+  int fd = open(path.c_str(), O_WRONLY);
+  if (fd == -1 || pwrite(fd, bytes.data(), size, offset) !=
+                     static_cast<ssize_t>(size))
+  {
+    std::fprintf(stderr, "can't write \"%s\"\n", path.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  close(fd);
+}
+
+// Inverts the byte at offset of the file at path.
+static void flip(const std::string& path, off_t offset)
+{
+  uint8_t byte = 0;
+
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd == -1 || pread(fd, &byte, 1, offset) != 1)
+  {
+    std::fprintf(stderr, "can't read \"%s\"\n", path.c_str());
+    std::exit(EXIT_FAILURE);
+  }
+  close(fd);
+
+  overwrite(path, offset, 1, ~byte);
+}
+
+// Fills cache with results 0 to count - 1.
+static void fill(ResultCache& cache, int count)
+{
+  for (int index = 0; index < count; ++index)
+  {
+    cache.Insert(kProgram, kBudget, make_result(index));
+  }
+}
+
+int main()
+{
+  TemporaryFile file;
+  file.Close();
+  std::string path = file.GetPath();
+
+  bool passed = true;
+  off_t size;
+
+  {
+    ResultCache cache(path, kSlots);
+    fill(cache, kCount);
+
+    if (count_found(cache, kCount, passed) != kCount)
+    {
+      std::fprintf(stderr, "results missing after inserting them\n");
+      passed = false;
+    }
+
+    SweepResult result;
+    if (cache.Find(kProgram + 1, make_result(0).input, kBudget, result) ||
+        cache.Find(kProgram, make_result(0).input, kBudget + 1, result))
+    {
+      std::fprintf(stderr, "found a result of another program or budget\n");
+      passed = false;
+    }
+
+    size = file_size(path);
+  }
+
+  {
+    // The slot count of an existing file wins.
+    ResultCache cache(path, kSlots * 4);
+
+    if (count_found(cache, kCount, passed) != kCount ||
+        file_size(path) != size)
+    {
+      std::fprintf(stderr, "results missing after reopening\n");
+      passed = false;
+    }
+
+    // Every new result must be found, pushing out older ones once its probe
+    // window is full.
+    for (int index = 0; index < 64; ++index)
+    {
+      SweepResult expected = make_result(index);
+      SweepResult result;
+
+      cache.Insert(kProgram, kBudget, expected);
+
+      if (!cache.Find(kProgram, expected.input, kBudget, result) ||
+          !same_result(result, expected))
+      {
+        std::fprintf(stderr, "result %d missing after inserting it\n",
+                     index);
+        passed = false;
+      }
+    }
+
+    if (count_found(cache, 64, passed) > static_cast<int>(kSlots))
+    {
+      std::fprintf(stderr, "more results found than there are slots\n");
+      passed = false;
+    }
+  }
+
+  // A slot torn anywhere reads as missing, never with other values. An empty
+  // file is a wrong size, so it starts empty.
+  if (truncate(path.c_str(), 0) == -1)
+  {
+    std::fprintf(stderr, "can't truncate \"%s\"\n", path.c_str());
+    return EXIT_FAILURE;
+  }
+
+  {
+    ResultCache cache(path, kSlots);
+    fill(cache, kCount);
+  }
+
+  for (off_t offset = kHeaderSize; offset < size; ++offset)
+  {
+    flip(path, offset);
+
+    ResultCache cache(path, kSlots);
+    if (count_found(cache, kCount, passed) < kCount - 1)
+    {
+      std::fprintf(stderr, "byte %lld damaged more than one result\n",
+                   static_cast<long long>(offset));
+      passed = false;
+      break;
+    }
+
+    flip(path, offset);
+  }
+
+  // Slots whose checksum fails are replaced.
+  {
+    overwrite(path, kHeaderSize, size - kHeaderSize, 0xA5);
+    ResultCache cache(path, kSlots);
+
+    if (count_found(cache, 64, passed) != 0)
+    {
+      std::fprintf(stderr, "found results in damaged slots\n");
+      passed = false;
+    }
+
+    fill(cache, kCount);
+    if (count_found(cache, kCount, passed) != kCount)
+    {
+      std::fprintf(stderr, "results missing after replacing damaged slots\n");
+      passed = false;
+    }
+  }
+
+  // A wrong magic, a wrong version or a wrong size empties the file.
+  for (const char* damage : { "magic", "version", "size" })
+  {
+    if (damage[0] == 'm') overwrite(path, 0, 1, 'X');
+    if (damage[0] == 'v') overwrite(path, 4, 4, 0xFF);
+    if (damage[0] == 's' && truncate(path.c_str(), size - 1) == -1)
+    {
+      std::fprintf(stderr, "can't truncate \"%s\"\n", path.c_str());
+      return EXIT_FAILURE;
+    }
+
+    ResultCache cache(path, kSlots);
+
+    if (count_found(cache, kCount, passed) != 0 || file_size(path) != size)
+    {
+      std::fprintf(stderr, "file with a wrong %s was not emptied\n", damage);
+      passed = false;
+    }
+
+    fill(cache, kCount);
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
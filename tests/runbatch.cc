@@ -0,0 +1,67 @@
+// Compares Emulator::RunBatch() with runs of each input on an engine of its
+// own, on every engine, for a program that halts for some inputs and loops
+// forever for the others.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/emulator.h"
+#include "tests/support.h"
+
+static const uint64_t kBudgets[] = { Emulator::kNoBudget, 100 };
+
+int main()
+{
+  ProgramData data = assemble(kSpinningMultiplySource);
+  TemporaryFile program = write_program(data);
+
+  std::vector<std::array<uint8_t, 2>> inputs;
+  for (int index = 0; index < (1 << 16); index += 2039)
+  {
+    inputs.push_back({ static_cast<uint8_t>(index >> 8),
+                       static_cast<uint8_t>(index) });
+  }
+
+  bool passed = true;
+
+  for (Engine::Type type : kEngines)
+  {
+    Emulator emulator(program.GetPath(), {}, true, type);
+
+    std::unique_ptr<Engine> machine = Engine::Create(type);
+    machine->Load(ROM(data));
+
+    for (uint64_t budget : kBudgets)
+    {
+      std::vector<Emulator::Result> results = emulator.RunBatch(inputs,
+                                                                budget);
+
+      for (size_t index = 0; index < inputs.size(); ++index)
+      {
+        const Emulator::Result& result = results[index];
+
+        machine->Reset();
+        machine->Input(inputs[index][0], inputs[index][1]);
+
+        uint64_t executed;
+        Emulator::Status status = Emulator::Run(*machine, budget, executed);
+        CPU::State state = machine->GetState();
+
+        if (result.status != status || result.executed != executed ||
+            memcmp(result.state.registers, state.registers,
+                   sizeof(state.registers)) != 0 ||
+            CPU::PackFlags(result.state) != CPU::PackFlags(state))
+        {
+          std::fprintf(stderr, "engine %d, budget %llu: input %d %d differs\n",
+                       static_cast<int>(type),
+                       static_cast<unsigned long long>(budget),
+                       inputs[index][0], inputs[index][1]);
+          passed = false;
+        }
+      }
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,67 @@
+// Runs machines on a Scheduler with several workers and short turns and
+// compares every machine with the same run on the reference engine.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "core/engine.h"
+#include "core/scheduler.h"
+#include "tests/support.h"
+
+static const uint64_t kBudget = 1000;
+static const uint64_t kQuantum = 37;
+static const unsigned kWorkers = 3;
+
+int main()
+{
+  ROM rom(assemble(kSpinningMultiplySource));
+  Scheduler scheduler(rom, kWorkers);
+
+  for (int index = 0; index < (1 << 16); index += 97)
+  {
+    scheduler.Add(index >> 8, index & 0xFF);
+  }
+
+  // Twice, so that the workers serve the rounds of more than one run
+  bool passed = true;
+
+  for (int run = 0; run < 2; ++run)
+  {
+    for (size_t index = 0; index < scheduler.Size(); ++index)
+    {
+      scheduler.Reset(index);
+    }
+
+    scheduler.Run(kBudget, kQuantum);
+
+    std::unique_ptr<Engine> machine = Engine::Create(Engine::Type::kReference);
+    machine->Load(rom);
+
+    for (size_t index = 0; index < scheduler.Size(); ++index)
+    {
+      const Scheduler::Instance& instance = scheduler.Get(index);
+
+      machine->Reset();
+      machine->Input(instance.input[0], instance.input[1]);
+
+      uint64_t executed = machine->Run(kBudget);
+      CPU::State state = machine->GetState();
+
+      if (instance.executed != executed ||
+          instance.state.halted != machine->Stopped() ||
+          memcmp(instance.state.registers, state.registers,
+                 sizeof(state.registers)) != 0 ||
+          CPU::PackFlags(instance.state) != CPU::PackFlags(state))
+      {
+        std::fprintf(stderr, "input %d %d: %llu instructions, expected "
+                     "%llu\n", instance.input[0], instance.input[1],
+                     static_cast<unsigned long long>(instance.executed),
+                     static_cast<unsigned long long>(executed));
+        passed = false;
+      }
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
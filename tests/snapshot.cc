@@ -0,0 +1,76 @@
+// Takes a snapshot in the middle of a run, finishes the run, restores the
+// snapshot with other inputs set in between and finishes the run again, on
+// every engine. Both runs must take the same number of steps to the same
+// state.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "core/emulator.h"
+#include "tests/support.h"
+
+// Instructions run before the snapshot
+static const uint64_t kBefore = 50;
+
+// Steps emulator until it halts, returns the number of steps.
+static uint64_t finish(Emulator& emulator)
+{
+  uint64_t steps = 0;
+
+  for (; !emulator.Stopped(); ++steps)
+  {
+    emulator.Step();
+  }
+
+  return steps;
+}
+
+int main()
+{
+  TemporaryFile program = write_program(assemble(kMultiplySource));
+
+  bool passed = true;
+
+  for (Engine::Type type : kEngines)
+  {
+    Emulator emulator(program.GetPath(), { 3, 200 }, true, type);
+
+    if (emulator.Run(kBefore) != Emulator::Status::kBudgetExhausted)
+    {
+      std::fprintf(stderr, "engine %d: halted before the snapshot\n",
+                   static_cast<int>(type));
+      passed = false;
+      continue;
+    }
+
+    MachineSnapshot snapshot = emulator.Snapshot();
+    uint64_t steps = finish(emulator);
+    CPU::State state = emulator.Snapshot().state;
+
+    emulator.Input(7, 1);
+    emulator.Restore(snapshot);
+
+    MachineSnapshot restored = emulator.Snapshot();
+    if (!same_state(restored.state, snapshot.state) ||
+        restored.input != snapshot.input ||
+        restored.stopped != snapshot.stopped)
+    {
+      std::fprintf(stderr, "engine %d: restored machine differs from the "
+                   "snapshot\n", static_cast<int>(type));
+      passed = false;
+    }
+
+    uint64_t restored_steps = finish(emulator);
+    if (restored_steps != steps ||
+        !same_state(emulator.Snapshot().state, state))
+    {
+      std::fprintf(stderr, "engine %d: %llu steps after restoring, expected "
+                   "%llu\n", static_cast<int>(type),
+                   static_cast<unsigned long long>(restored_steps),
+                   static_cast<unsigned long long>(steps));
+      passed = false;
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstring>
+
+#include "tests/support.h"
+#include "compiler/run.h"
+
+const char kMultiplySource[] =
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "movi c, 0\n"
+    "loop:\n"
+    "or f, b, b\n"
+    "jmp z, done\n"
+    "add c, c, a\n"
+    "sub b, b, 1\n"
+    "jmp loop\n"
+    "done:\n"
+    "halt\n";
+
+const char kSpinningMultiplySource[] =
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "shr f, a\n"
+    "jmp nc, spin\n"
+    "movi c, 0\n"
+    "loop:\n"
+    "or f, b, b\n"
+    "jmp z, done\n"
+    "add c, c, a\n"
+    "sub b, b, 1\n"
+    "jmp loop\n"
+    "done:\n"
+    "halt\n"
+    "spin:\n"
+    "jmp spin\n";
+
+const std::vector<Engine::Type> kEngines = {
+  Engine::Type::kReference, Engine::Type::kThreaded, Engine::Type::kBlocks,
+  Engine::Type::kMemo, Engine::Type::kNative
+};
+
+bool same_state(const CPU::State& first, const CPU::State& second)
+{
+  return memcmp(first.registers, second.registers,
+                sizeof(first.registers)) == 0 &&
+         first.instruction == second.instruction &&
+         CPU::PackFlags(first) == CPU::PackFlags(second) &&
+         first.halted == second.halted;
+}
+
+bool same_result(const SweepResult& first, const SweepResult& second)
+{
+  return first.input == second.input && first.status == second.status &&
+         memcmp(first.registers, second.registers,
+                sizeof(first.registers)) == 0 &&
+         first.flags == second.flags && first.executed == second.executed;
+}
+
+ProgramData assemble(const char* source)
+{
+  std::vector<uint16_t> words = compile_source(source);
+  ProgramData program = {};
+  std::copy(words.begin(), words.end(), program.begin());
+
+  return program;
+}
+
+TemporaryFile write_program(const ProgramData& program)
+{
+  TemporaryFile file;
+
+  for (uint16_t word : program)
+  {
+    file.Write(static_cast<uint8_t>(word >> 8));
+    file.Write(static_cast<uint8_t>(word));
+  }
+
+  file.Close();
+  return file;
+}
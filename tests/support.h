@@ -0,0 +1,35 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "core/cpu.h"
+#include "core/engine.h"
+#include "core/rom.h"
+#include "core/sweep.h"
+#include "utils/tempfile.h"
+
+// Programs, engines and helpers shared by the tests.
+
+typedef std::array<uint16_t, ROM::kProgramDataSize> ProgramData;
+
+// Multiplies the input switches into C by repeated addition
+extern const char kMultiplySource[];
+
+// Same as kMultiplySource, but spins forever when the first input is even
+extern const char kSpinningMultiplySource[];
+
+// Every engine, the reference engine first
+extern const std::vector<Engine::Type> kEngines;
+
+// Returns true if first and second have the same registers, instruction
+// register, flags and halted flag.
+bool same_state(const CPU::State& first, const CPU::State& second);
+
+bool same_result(const SweepResult& first, const SweepResult& second);
+
+// Compiles source into a whole program, padded with zero words.
+ProgramData assemble(const char* source);
+
+// Writes program to a closed temporary file, to be loaded by Emulator.
+TemporaryFile write_program(const ProgramData& program);
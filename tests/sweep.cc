@@ -0,0 +1,124 @@
+// Compares sweeps run in lockstep with sweeps run one input at a time on the
+// reference engine, for programs that halt after a few or many instructions
+// depending on the input, that loop for some inputs and with small budgets.
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "core/sweep.h"
+#include "tests/support.h"
+
+struct Program
+{
+  const char* name;
+  const char* source;
+};
+
+static const Program kPrograms[] = {
+  { "multiply", kMultiplySource },
+  { "mix",
+    "load a, 0x80\n"
+    "load b, 0x81\n"
+    "movi d, 0x10\n"
+    "movi m, 0x80\n"
+    "load c, m\n"
+    "call subr\n"
+    "xor a, a, b\n"
+    "not b, a\n"
+    "ror c, b\n"
+    "shr d, c\n"
+    "rcr a, d\n"
+    "adc b, a, 7\n"
+    "sbc c, b, d\n"
+    "and f, c, 3\n"
+    "movi nz, a, 0x55\n"
+    "movi z, b, 0x66\n"
+    "mov s, a\n"
+    "sub f, a, b\n"
+    "jmp c, tail\n"
+    "add a, a, 1\n"
+    "tail:\n"
+    "halt\n"
+    "subr:\n"
+    "add d, d, 5\n"
+    "sub d, d, 7\n"
+    "mov pc, l\n" },
+  // Spins forever when the first input is even
+  { "spin",
+    "load a, 0x80\n"
+    "shr f, a\n"
+    "jmp c, odd\n"
+    "spin:\n"
+    "jmp spin\n"
+    "odd:\n"
+    "halt\n" },
+  // Halts after more than Emulator::kRunQuantum instructions
+  { "count",
+    "movi a, 0\n"
+    "movi b, 0\n"
+    "lp:\n"
+    "add a, a, 1\n"
+    "adc b, b, 0\n"
+    "or f, b, b\n"
+    "jmp ns, lp\n"
+    "halt\n" }
+};
+
+static const uint64_t kBudgets[] = { Emulator::kNoBudget, 300, 1 };
+
+static bool check(const char* name, const ROM& rom, uint64_t budget,
+                  const std::vector<std::array<uint8_t, 2>>& inputs,
+                  SweepMode mode, const char* mode_name)
+{
+  std::vector<SweepResult> expected = sweep(rom, inputs,
+                                            Engine::Type::kReference, budget,
+                                            1);
+  std::vector<SweepResult> results = sweep(rom, inputs,
+                                           Engine::Type::kReference, budget,
+                                           1, nullptr, mode);
+
+  for (size_t index = 0; index < inputs.size(); ++index)
+  {
+    if (!same_result(expected[index], results[index]))
+    {
+      std::fprintf(stderr, "%s: %s, budget %llu: input %d %d: %s after %llu, "
+                   "expected %s after %llu\n", name, mode_name,
+                   static_cast<unsigned long long>(budget), inputs[index][0],
+                   inputs[index][1], status_name(results[index].status),
+                   static_cast<unsigned long long>(results[index].executed),
+                   status_name(expected[index].status),
+                   static_cast<unsigned long long>(expected[index].executed));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main()
+{
+  // Every 251st input, so that lanes get inputs of every kind
+  std::vector<std::array<uint8_t, 2>> inputs;
+  for (size_t index = 0; index < (1 << 16); index += 251)
+  {
+    inputs.push_back({ static_cast<uint8_t>(index >> 8),
+                       static_cast<uint8_t>(index) });
+  }
+
+  bool passed = true;
+
+  for (const Program& program : kPrograms)
+  {
+    ROM rom(assemble(program.source));
+
+    for (uint64_t budget : kBudgets)
+    {
+      passed &= check(program.name, rom, budget, inputs, SweepMode::kLanes,
+                      "lanes");
+      passed &= check(program.name, rom, budget, inputs, SweepMode::kSliced,
+                      "sliced");
+    }
+  }
+
+  return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,5 +1,6 @@
 #include "ui/mainform.h"
 #include "ui/inputdialog.h"
+#include "core/loopdetector.h"
 #include "compiler/run.h"
 
 #include "ui/resources/run.xpm"
@@ -145,14 +146,24 @@ void reMainForm::EnableStop(bool enable)
 
 void reMainForm::RunEmulatorThread()
 {
-  auto FinalAction = [this]() { background_thread_.join(); Stop(); };
+  // Every state is sampled, as instructions are executed one at a time.
+  LoopDetector loops;
+  uint64_t executed = 0;
+  Emulator::Status status = Emulator::Status::kHalted;
 
   while (!emulator_.Stopped())
   {
+    if (executed == kRunBudget)
+    {
+      status = Emulator::Status::kBudgetExhausted;
+      break;
+    }
+
     std::this_thread::sleep_for(std::chrono::duration<int, std::milli>(
         kMillisecondsPerCycle / speed_slider_->GetValue()));
 
     emulator_.Step();
+    ++executed;
     CallAfter([this]() { Update(); });
 
     if (state_ == State::kClosing)
@@ -162,12 +173,23 @@ void reMainForm::RunEmulatorThread()
     }
     else if (state_ == State::kStopping)
     {
-      CallAfter(FinalAction);
+      CallAfter([this]() { background_thread_.join(); Stop(); });
       return;
     }
+
+    if (!emulator_.Stopped() && loops.Check(emulator_.Snapshot().state))
+    {
+      status = Emulator::Status::kLooped;
+      break;
+    }
   }
 
-  CallAfter(FinalAction);
+  CallAfter([this, status]()
+  {
+    background_thread_.join();
+    Stop();
+    Report(status);
+  });
 }
 
 void reMainForm::Update()
@@ -239,6 +261,30 @@ void reMainForm::Raise(const std::string& msg)
   }
 }
 
+void reMainForm::Report(Emulator::Status status)
+{
+  wxString message;
+
+  switch (status)
+  {
+    case Emulator::Status::kLooped:
+      message = "Program loops forever.";
+      break;
+    case Emulator::Status::kBudgetExhausted:
+      message = wxString::Format("Program did not halt within %llu "
+                                 "instructions.",
+                                 static_cast<unsigned long long>(kRunBudget));
+      break;
+    default:
+      return;
+  }
+
+  wxMessageDialog info_msg(nullptr, message, "Run stopped",
+                           wxICON_INFORMATION | wxOK);
+
+  info_msg.ShowModal();
+}
+
 void reMainForm::OnLoad(wxCommandEvent& event)
 {
   wxFileDialog file_dialog(this, "Open binary file with program", "", "", "",
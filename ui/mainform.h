@@ -33,6 +33,9 @@ class reMainForm : public wxFrame
   public:
     const int kMillisecondsPerCycle = 2000;
 
+    // Instructions a run executes before it is stopped
+    const uint64_t kRunBudget = 10000;
+
   public:
     reMainForm();
 
@@ -42,6 +45,9 @@ class reMainForm : public wxFrame
     void Load(const wxString& path);
     void Raise(const std::string& msg);
 
+    // Tells the user why a run ended if the program did not halt.
+    void Report(Emulator::Status status);
+
     void OnLoad(wxCommandEvent& event);
     void OnCompileAndLoad(wxCommandEvent& event);
     void OnRun(wxCommandEvent& event);
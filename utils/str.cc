@@ -34,7 +34,8 @@ std::string to_hex_string(int val, int width)
   return hex.str();
 }
 
-uint8_t asm_stoi(const std::string& Imm)
+int asm_stoi(const std::string& Imm)
+try
 {
   if (!Imm.compare(0, 2, "0x") || !Imm.compare(0, 2, "0X"))
   {
@@ -54,3 +55,8 @@ uint8_t asm_stoi(const std::string& Imm)
   }
   throw std::runtime_error("invalid immediate value");
 }
+catch (const std::logic_error&)
+{
+  // std::stoi throws std::invalid_argument and std::out_of_range.
+  throw std::runtime_error("invalid immediate value: \"" + Imm + "\"");
+}
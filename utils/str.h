@@ -6,4 +6,6 @@ bool strisdigit(const std::string& str);
 
 std::string to_hex_string(int val, int width = 1);
 
-uint8_t asm_stoi(const std::string& Imm);
+// Parses a non-negative immediate value. Throws std::runtime_error if it is
+// malformed or does not fit an int.
+int asm_stoi(const std::string& Imm);